@@ -0,0 +1,253 @@
+#pragma once
+#include <atomic>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+// USER DEFINED IMPORTS
+#include "Logger.cpp"
+#include "ServerConfig.cpp"
+
+using std::string;
+
+// AdminSocket lets an operator read and change the settings of a running Server through a Unix domain socket, which only
+// the owner of the server process may connect to. Each line sent is a command, answered by zero or more lines followed by
+// a line starting with "ok" or "error":
+//
+//     get                  Every setting, as a configuration file would hold it.
+//     set <key> <value>    Change a setting, publishing a new version of the configuration.
+//     reload               Apply the configuration file again.
+//
+// Clients are served one at a time, on a thread of its own.
+class AdminSocket
+{
+
+    private:
+
+        io_service m_ioService; // The IO Service m_acceptor and its clients are created on.
+        boost::scoped_ptr<local::stream_protocol::acceptor> m_acceptor; // Accepts administrators.
+        local::stream_protocol::socket* m_client; // The administrator being served, or nullptr.
+        boost::mutex m_clientMutex; // Guards m_client, so close() can interrupt the administrator being served.
+        ServerConfigStore* m_config; // The settings administered.
+        string m_path; // The path m_acceptor is bound to.
+        std::atomic<bool> m_running; // The running status of m_thread.
+        boost::thread m_thread; // Accepts and serves administrators.
+
+        // Execute(line) runs the command, line, and returns its reply.
+        string execute(const string& line)
+        {
+
+            std::istringstream words{line};
+            string command, key, value, error;
+            words >> command;
+
+            if(command == "get")
+            {
+
+                return ServerConfigStore::format(m_config->current()) + "ok\n";
+
+            }
+            else if(command == "set")
+            {
+
+                words >> key;
+                std::getline(words >> std::ws, value);
+
+                if(!m_config->set(key, value, error)) { return "error " + error + "\n"; }
+
+            }
+            else if(command == "reload")
+            {
+
+                if(!m_config->reload(error)) { return "error " + error + "\n"; }
+
+            }
+            else
+            {
+
+                return "error unknown command '" + command + "'; use get, set <key> <value> or reload\n";
+
+            }
+
+            return "ok version " + std::to_string(m_config->current().version) + "\n";
+
+        }
+
+        // Serve(client) answers every command client sends until it disconnects.
+        void serve(local::stream_protocol::socket& client)
+        {
+
+            boost::asio::streambuf input;
+            boost::system::error_code error;
+
+            while(m_running)
+            {
+
+                boost::asio::read_until(client, input, '\n', error);
+
+                if(error) { return; }
+
+                std::istream stream{&input};
+                string line;
+                std::getline(stream, line);
+
+                if(!line.empty() && line.back() == '\r') { line.pop_back(); }
+
+                if(line.empty()) { continue; }
+
+                boost::asio::write(client, boost::asio::buffer(execute(line)), error);
+
+                if(error) { return; }
+
+            }
+        }
+
+        // IsOwner(client) returns true if the process at the other end of client runs as the same user as this one.
+        static bool isOwner(local::stream_protocol::socket& client)
+        {
+
+            struct ucred credentials;
+            socklen_t length = sizeof(credentials);
+
+            if(::getsockopt(client.native_handle(), SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) { return false; }
+
+            return credentials.uid == ::geteuid();
+
+        }
+
+        // Run() is the body of m_thread.
+        void run()
+        {
+
+            while(m_running)
+            {
+
+                local::stream_protocol::socket client{m_ioService};
+                boost::system::error_code error;
+                m_acceptor->accept(client, error);
+
+                if(error) { return; }
+
+                // The permissions of the socket keep others out; this holds even if they were loosened afterwards.
+                if(!isOwner(client))
+                {
+
+                    Logger::getInstance().log(LOG_WARN, "[Server]: Refused an administrator running as another user.");
+                    continue;
+
+                }
+
+                {
+
+                    boost::lock_guard<boost::mutex> lock{m_clientMutex};
+
+                    if(!m_running) { return; }
+
+                    m_client = &client;
+
+                }
+
+                serve(client);
+                boost::lock_guard<boost::mutex> lock{m_clientMutex};
+                m_client = nullptr;
+
+            }
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        AdminSocket(const AdminSocket& rhs) = delete;
+        AdminSocket& operator=(const AdminSocket& rhs) = delete;
+
+        // Default constructor. Nothing is accepted until open(..) is called.
+        AdminSocket() noexcept : m_client{nullptr}, m_config{nullptr}, m_running{false} {}
+
+        // Destructor that closes the socket.
+        ~AdminSocket()
+        {
+
+            close();
+
+        }
+
+        // Open(path, config) starts administering config through a Unix domain socket at path. It returns false if the
+        // socket cannot be created.
+        bool open(const string& path, ServerConfigStore& config)
+        {
+
+            try
+            {
+
+                // Bind under a umask that leaves the socket to its owner alone from the start; a chmod(..) after bind(..)
+                // would leave it open to others in between. The umask is process wide, so this happens while starting up.
+                ::unlink(path.c_str());
+                const mode_t previousMask = ::umask(S_IRWXG | S_IRWXO | S_IXUSR);
+
+                try
+                {
+
+                    m_acceptor.reset(new local::stream_protocol::acceptor{m_ioService, local::stream_protocol::endpoint(path)});
+
+                }
+                catch(const std::exception& e)
+                {
+
+                    ::umask(previousMask);
+                    throw;
+
+                }
+
+                ::umask(previousMask);
+
+            }
+            catch(const std::exception& e)
+            {
+
+                m_acceptor.reset();
+                return false;
+
+            }
+
+            m_path = path;
+            m_config = &config;
+            m_running = true;
+            m_thread = boost::thread{boost::bind(&AdminSocket::run, this)};
+            return true;
+
+        }
+
+        // Close() stops accepting administrators, disconnects the one being served, and removes the socket.
+        void close()
+        {
+
+            if(!m_running.exchange(false)) { return; }
+
+            {
+
+                // Closing a socket does not wake a thread blocked accepting on it, but shutting it down does.
+                boost::lock_guard<boost::mutex> lock{m_clientMutex};
+                boost::system::error_code ignored;
+                ::shutdown(m_acceptor->native_handle(), SHUT_RDWR);
+                m_acceptor->close(ignored);
+
+                if(m_client != nullptr) { m_client->shutdown(local::stream_protocol::socket::shutdown_both, ignored); }
+
+            }
+
+            if(m_thread.joinable()) { m_thread.join(); }
+
+            m_acceptor.reset();
+            ::unlink(m_path.c_str());
+
+        }
+};
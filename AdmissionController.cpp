@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// The load signals AdmissionController weighs.
+enum AdmissionSignal
+{
+
+    ADMISSION_CONNECTIONS, // Occupied connection slots.
+    ADMISSION_OUTBOUND_BYTES, // Bytes queued for connections that could not take them yet.
+    ADMISSION_LOOP_LAG, // How late the accept loop runs a timer, in milliseconds.
+    ADMISSION_ACCEPT_QUEUE, // Connections the kernel holds that the accept loop has not taken yet.
+    ADMISSION_NUM_SIGNALS
+
+};
+
+// AdmissionLimits are the levels of the load signals, indexed by AdmissionSignal, past which new connections are
+// rejected. A limit of 0 disables its signal.
+struct AdmissionLimits
+{
+
+    uint64_t limits[ADMISSION_NUM_SIGNALS];
+
+};
+
+// AdmissionController decides whether a Server admits a new connection, from live load signals. Once any signal reaches
+// its limit the server counts as overloaded, and stays so until every signal falls below RESUME_PERCENT of its limit, so
+// admission does not flap around a limit. Connections already admitted are never affected.
+//
+// A rejected connection is told when to try again. The hint grows with the square of the load relative to the limits,
+// from MIN_RETRY_MS up to MAX_RETRY_MS, so the further the server is past its limits, the longer clients stay away.
+class AdmissionController
+{
+
+    public:
+
+        inline static const uint64_t DEFAULT_MAX_CONNECTIONS = 100000; // The default limit of each signal.
+        inline static const uint64_t DEFAULT_MAX_OUTBOUND_BYTES = 512 << 20;
+        inline static const uint64_t DEFAULT_MAX_LOOP_LAG_MS = 250;
+        inline static const uint64_t DEFAULT_MAX_ACCEPT_QUEUE = 1024;
+        inline static const uint32_t RESUME_PERCENT = 90; // Admit again once every signal is below this share of its limit.
+        inline static const uint32_t MIN_RETRY_MS = 1000; // The range of the retry hint.
+        inline static const uint32_t MAX_RETRY_MS = 60000;
+
+    private:
+
+        std::atomic<uint64_t> m_sampled[ADMISSION_NUM_SIGNALS]; // The signals sampled by the owner, rather than passed to admit(..).
+        std::atomic<bool> m_overloaded; // True while new connections are rejected.
+        std::atomic<uint64_t> m_numRejected; // The number of connections rejected.
+
+    public:
+
+        // Suppress copy semantics.
+        AdmissionController(const AdmissionController& rhs) = delete;
+        AdmissionController& operator=(const AdmissionController& rhs) = delete;
+
+        // Default constructor.
+        AdmissionController() noexcept : m_sampled{}, m_overloaded{false}, m_numRejected{0} {}
+
+        // Record(signal, value) records the latest sample of signal.
+        inline void record(AdmissionSignal signal, uint64_t value) noexcept
+        {
+
+            m_sampled[signal].store(value, std::memory_order_relaxed);
+
+        }
+
+        // Admit(limits, numConnections, outboundBytes, retryAfterMs, signal) returns true if a new connection may be admitted
+        // under limits, given the signals passed and those last recorded. Either way it stores the signal closest to, or
+        // furthest past, its limit in signal, and how long a rejected client should wait in retryAfterMs (0 if admitted).
+        bool admit(const AdmissionLimits& limits, uint64_t numConnections, uint64_t outboundBytes, uint32_t& retryAfterMs, AdmissionSignal& signal) noexcept
+        {
+
+            record(ADMISSION_CONNECTIONS, numConnections);
+            record(ADMISSION_OUTBOUND_BYTES, outboundBytes);
+
+            // The load is the highest ratio of any signal to its limit.
+            double load = 0;
+            signal = ADMISSION_CONNECTIONS;
+            retryAfterMs = 0;
+
+            for(int index = 0; index < ADMISSION_NUM_SIGNALS; index++)
+            {
+
+                if(limits.limits[index] == 0) { continue; }
+
+                const double ratio = static_cast<double>(m_sampled[index].load(std::memory_order_relaxed)) / limits.limits[index];
+
+                if(ratio > load)
+                {
+
+                    load = ratio;
+                    signal = static_cast<AdmissionSignal>(index);
+
+                }
+            }
+
+            const bool overloaded = load >= (m_overloaded ? RESUME_PERCENT / 100.0 : 1.0);
+            m_overloaded = overloaded;
+
+            if(!overloaded) { return true; }
+
+            m_numRejected++;
+            retryAfterMs = static_cast<uint32_t>(std::min<double>(MAX_RETRY_MS, MIN_RETRY_MS * std::max(1.0, load * load)));
+            return false;
+
+        }
+
+        // IsOverloaded() returns true while new connections are rejected.
+        inline bool isOverloaded() const noexcept
+        {
+
+            return m_overloaded.load();
+
+        }
+
+        // GetNumRejected() returns the number of connections rejected.
+        inline uint64_t getNumRejected() const noexcept
+        {
+
+            return m_numRejected.load();
+
+        }
+
+        // NameOf(signal) returns a readable name of signal.
+        static const char* nameOf(AdmissionSignal signal) noexcept
+        {
+
+            static const char* names[ADMISSION_NUM_SIGNALS] = {"connections", "outbound queued bytes", "accept loop lag", "accept queue"};
+            return names[signal];
+
+        }
+};
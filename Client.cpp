@@ -1,10 +1,21 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <random>
 #include <string>
 #include <boost/asio.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/lockfree/queue.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <unistd.h>
 #include "PacketTagTypes.cpp"
+#include "Session.cpp"
+#include "ShmSession.cpp"
+#include "FrameScanner.cpp"
+#include "FileTransferAgent.cpp"
+#include "TerminalRenderer.cpp"
 
 using namespace boost::asio;
 using ip::tcp;
@@ -18,74 +29,462 @@ typedef unsigned int uint;
 class Client
 {
 
+    public:
+
+        typedef boost::function<void(const string& tag, const string& content)> FrameHandler;
+
     private:
 
-        string m_hostName; // The host name that this Client object is connected to.
+        inline static const uint SHM_RING_CAPACITY = 1 << 20; // The size of each shared-memory ring, in bytes, when m_useSharedMemory is set.
+        inline static const uint READ_CHUNK_SIZE = 4096; // The most bytes taken from the transport by a single read.
+        inline static const size_t SEND_QUEUE_CAPACITY = 1024; // The packets m_sendQueue holds before it has to allocate.
+        inline static const size_t MAX_COALESCED_BYTES = 64 * 1024; // The most queued bytes gathered into a single write.
+        inline static const uint MAX_RETRIES = 8; // The most times in a row a client turned away by a busy server tries again.
+        inline static const uint MAX_RETRY_BACKOFF_SHIFT = 5; // The retry window doubles with each retry in a row, at most this many times.
+
+        string m_hostName; // The host name that this Client object is connected to. A host name beginning with '/' is a Unix domain socket path.
         uint m_portNum; // The port number of the server that this Client object is connected to.
         string m_nickname; // The nickname of this Client object.
-        bool m_connected; // The connection status of this Client object.
-        boost::scoped_ptr<tcp::socket> m_tcpSocket; // A scoped pointer that refers to the tcp::socket connection of this Client object.
+        std::atomic<bool> m_connected; // The connection status of this Client object.
+        bool m_useSharedMemory; // If set, a local connection exchanges packets through a shared-memory ring pair.
+        bool m_async; // If set, the transport is driven by m_ioThread and sends are queued (@see sendParamToServer(..)).
+        io_service m_ioService; // The IO Service that m_session is created on.
+        boost::shared_ptr<Session> m_session; // A shared pointer that refers to the transport (TCP, Unix domain socket or shared memory) of this Client object; only accessed through getSession() and setSession(..), as a reconnect replaces it while other threads use it.
+        boost::mutex m_writeMutex; // Serialises synchronous writes from the input thread and the read thread.
+        string m_readBuffer; // Received bytes that do not yet form a complete packet.
+        std::vector<uint32_t> m_boundaries; // The packet terminators found by the most recent read.
+        FrameHandler m_frameHandler; // Receives every inbound packet, other than pings, instead of the standard output stream. May be empty.
+        FileTransferAgent m_files; // Sends and receives the files of this Client object.
+        TerminalRenderer m_display; // Displays inbound packets on its own thread, so a slow terminal never holds up reads.
+        std::atomic<uint> m_retryAfterMs; // How long the server asked this Client object to wait before trying again, or 0.
+        std::atomic<bool> m_retrying; // True while waiting to try again; packets sent meanwhile are dropped.
+        uint m_numRetries; // The number of retries in a row that the server has turned away.
+        std::mt19937 m_random; // Jitters the retry delays.
+        deadline_timer m_retryTimer; // Asynchronous mode only: fires when it is time to try again.
+
+        // Asynchronous mode only.
+        boost::scoped_ptr<io_service::work> m_work; // Keeps m_ioService running while no operation is pending.
+        boost::thread m_ioThread; // The thread that runs m_ioService.
+        boost::lockfree::queue<string*> m_sendQueue; // Packets queued by sendParamToServer(..) that m_ioThread has not written yet.
+        std::atomic<bool> m_writeScheduled; // True while a flush of m_sendQueue is posted or a write is in progress.
+        string m_writeBuffer; // The packets of the write in progress, coalesced.
+        char m_readChunk[READ_CHUNK_SIZE]; // The buffer the read in progress fills.
+
+        // GetSession() returns the current transport of this Client object, which may be null.
+        boost::shared_ptr<Session> getSession() const
+        {
+
+            return boost::atomic_load(&m_session);
+
+        }
+
+        // SetSession(session) makes session the current transport of this Client object.
+        void setSession(const boost::shared_ptr<Session>& session)
+        {
+
+            boost::atomic_store(&m_session, session);
+
+        }
+
+        // ConnectLocal() connects to the Unix domain socket at m_hostName and, if requested, negotiates a shared-memory ring pair.
+        void connectLocal()
+        {
+
+            boost::shared_ptr<LocalSession> localSession{new LocalSession{m_ioService}};
+            localSession->getSocket().connect(local::stream_protocol::endpoint(m_hostName));
+            setSession(localSession);
+
+            if(!m_useSharedMemory) { return; }
+
+            // Name the segment after this process so concurrent local clients never collide. The server unlinks the
+            // name as soon as it has mapped the segment.
+            const string& segmentName = ShmRingPair::NAME_PREFIX + std::to_string(getpid()) + "-" + std::to_string(reinterpret_cast<uintptr_t>(this));
+            ShmRingPair* rings = new ShmRingPair;
+
+            try
+            {
+
+                rings->create(segmentName, SHM_RING_CAPACITY);
+
+            }
+            catch(const std::exception& e)
+            {
+
+                delete rings;
+                cerr << "[Client]: " << e.what() << ", falling back to the Unix domain socket." << endl;
+                return;
+
+            }
+
+            boost::system::error_code error;
+            localSession->write(boost::asio::buffer(PacketTagTypes::PKT_SHM + segmentName + ";"), error);
+
+            if(error)
+            {
+
+                shm_unlink(segmentName.c_str());
+                delete rings;
+                throw boost::system::system_error{error};
+
+            }
+
+            setSession(boost::shared_ptr<Session>{new ShmSession{rings, localSession}});
+
+        }
 
         // Synchronous operations
 
         // StartPacketRead() is a synchronous blocking method that will block until it encounters an incoming packet.
-        // It then invokes the appropriate methods to process and handle each packet.
+        // It then invokes the appropriate methods to process and handle each packet, and repeats while connected.
         void startPacketRead()
         {
 
-            // If this socket is inactive, it cannot possibly receive any incoming packets.
-            // So we check to be sure.
-            if(m_tcpSocket.get() == nullptr || !isConnected()) { return; }
-            
             // Declare a buffer of characters to synchronously receive any incoming packets.
-            char buf[256];
+            char buf[READ_CHUNK_SIZE];
 
-            try
+            // If this socket is inactive, it cannot possibly receive any incoming packets.
+            // So we check to be sure.
+            while(getSession().get() != nullptr && isConnected())
             {
 
-                (*m_tcpSocket).receive(boost::asio::buffer(buf));
-                handlePacketRead(buf);
+                try
+                {
+
+                    boost::system::error_code error;
+                    size_t numBytes = getSession()->readSome(boost::asio::buffer(buf, sizeof(buf)), error);
+
+                    if(error) { throw boost::system::system_error{error}; }
+
+                    handleReceivedBytes(buf, numBytes);
+
+                }
+                catch(const std::exception& err) {
 
+                    // A server that turned this client away asked it to try again later.
+                    if(m_retryAfterMs != 0 && retryConnect()) { continue; }
+
+                    cout << endl;
+                    disconnect();
+
+                }
             }
-            catch(const std::exception& err) {
+        }
+
+        // HandleReceivedBytes(data, numBytes) handles every packet completed by numBytes newly received bytes, data. A single
+        // read may hold several packets and end part way through another; the remainder waits for the next read.
+        void handleReceivedBytes(const char* data, size_t numBytes)
+        {
+
+            const uint32_t scanFrom = m_readBuffer.length();
+            m_readBuffer.append(data, numBytes);
+            m_boundaries.clear();
+            FrameScanner::scan(m_readBuffer.data(), scanFrom, m_readBuffer.length(), ';', m_boundaries);
+            size_t packetStart = 0;
 
-                cout << endl;
-                disconnect();
+            for(const uint32_t packetEnd : m_boundaries)
+            {
+
+                handlePacketRead(m_readBuffer.substr(packetStart, packetEnd + 1 - packetStart));
+                packetStart = packetEnd + 1;
 
-            }   
+            }
 
-            // Recursively invoke this method.
-            startPacketRead();
+            m_readBuffer.erase(0, packetStart);
 
         }
 
-        // HandlePacketRead(buf) handles the data that was synchronously read into buf. It will logically determine
+        // HandlePacketRead(data) handles a single packet, data, including its terminating ';'. It will logically determine
         // if it is important data that the user should see.
-        void handlePacketRead(const char* buf)
+        void handlePacketRead(const string& data)
         {
             
-            std::string data(buf); // Convert c-style buffer to a std::string
+            if(data.length() < 4) { return; }
+
             const string& tag = data.substr(0, 3); // The packet tag is always the first 3 characters; so let's extract that.
 
             // We are only interested in displaying messages to the user. We want to ignore other
             // packet types such as ping checks, etc.
             if(tag == PacketTagTypes::PKT_PING || tag == PacketTagTypes::PKT_NICKNAME) { return; }
 
-            // Here we need to find the index of the final semicolon so we can print the contents
-            // of the message that precede it.
-            uint terminatorIndex = data.length() - 1; // Start at the last index of the string.
+            // The server is busy, and will close the connection; remember when it asked this client to try again.
+            if(tag == PacketTagTypes::PKT_RETRY)
+            {
+
+                const size_t reasonStart = data.find(' ');
+                m_retryAfterMs = std::max<uint>(1, static_cast<uint>(strtoul(data.c_str() + 3, nullptr, 10)));
+                m_display.post(reasonStart == string::npos ? "[Client]: The server is busy." : data.substr(reasonStart + 1, data.length() - reasonStart - 2));
+                return;
+
+            }
 
-            // Run a busy loop that backtracks until it encounters the first ';' character.
-            while(data[terminatorIndex] != ';') 
+            m_numRetries = 0;
+
+            // The server is tracing the message before this one; report that it arrived.
+            if(tag == PacketTagTypes::PKT_TRACE)
             {
 
-                terminatorIndex--;
+                boost::system::error_code ignored;
+                sendParamToServer(data.substr(3), PacketTagTypes::PKT_TRACE, ignored);
+                return;
 
-            } 
+            }
+
+            // Store the content, which lies between the tag and the terminator, and print to the standard output stream.
+            const string& content = data.substr(3, data.length() - 4);
+
+            // File transfer packets are handled, and reported, by m_files.
+            if(m_files.handlePacket(tag, content)) { return; }
+
+            if(m_frameHandler)
+            {
+
+                m_frameHandler(tag, content);
+                return;
+
+            }
+
+            m_display.post(content);
+
+        }
+
+        // SendPacket(message, tag) sends a packet on behalf of m_files.
+        void sendPacket(const string& message, const string& tag)
+        {
+
+            boost::system::error_code ignored;
+            sendParamToServer(message, tag, ignored);
+
+        }
+
+        // OpenSession() connects a new transport to the server, replacing m_session.
+        void openSession()
+        {
+
+            if(isLocal())
+            {
+
+                connectLocal();
+                cout << "Client successfully connected to [" << m_hostName << "] (" << getSession()->getTransportName() << ")" << endl;
+
+            }
+            else
+            {
+
+                boost::shared_ptr<TcpSession> tcpSession{new TcpSession{m_ioService}};
+                tcpSession->getSocket().connect(tcp::endpoint(boost::asio::ip::address::from_string(m_hostName), m_portNum));
+                setSession(tcpSession);
+                cout << "Client successfully connected to [" << m_hostName << ", " << m_portNum << "]" << endl;
+
+            }
+        }
+
+        // NextRetryDelay() returns how long to wait before the next retry: the server's hint, plus a random share of a window
+        // that doubles with each retry in a row. Clients turned away together so come back spread out, rather than together.
+        uint nextRetryDelay()
+        {
+
+            const uint hint = m_retryAfterMs;
+            const uint window = hint << std::min(m_numRetries, MAX_RETRY_BACKOFF_SHIFT);
+            m_numRetries++;
+            return hint + std::uniform_int_distribution<uint>{0, window}(m_random);
+
+        }
+
+        // Reconnect() replaces the connection to the server with a new one, and sends the nickname of this Client object
+        // again. It returns false if the server could not be reached.
+        bool reconnect()
+        {
+
+            try
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_writeMutex};
+                boost::system::error_code error;
+                getSession()->close();
+                openSession();
+                getSession()->write(boost::asio::buffer(PacketTagTypes::PKT_NICKNAME + m_nickname + ";"), error);
+
+                if(error) { return false; }
+
+            }
+            catch(const std::exception& e)
+            {
+
+                return false;
+
+            }
+
+            m_retryAfterMs = 0;
+            m_retrying = false;
+            return true;
+
+        }
+
+        // RetryConnect() waits as the server asked, with jitter, then reconnects, until it succeeds or MAX_RETRIES retries in
+        // a row have failed. It returns false in the latter case. Synchronous mode only.
+        bool retryConnect()
+        {
+
+            m_retrying = true;
+
+            while(m_numRetries < MAX_RETRIES && isConnected())
+            {
+
+                const uint delay = nextRetryDelay();
+                m_display.post("[Client]: Trying again in " + std::to_string((delay + 500) / 1000) + " seconds.");
+                boost::this_thread::sleep(boost::posix_time::milliseconds(delay));
+
+                if(reconnect()) { return true; }
+
+            }
+
+            m_retrying = false;
+            return false;
+
+        }
 
-            // Store the content as a substring and print to the standard output stream.
-            const string& content = data.substr(3, terminatorIndex - 3);
-            cout << content << endl;
+        // Asynchronous operations
+
+        // ScheduleRetry() reconnects, on m_ioThread, once the delay the server asked for, with jitter, has passed.
+        void scheduleRetry()
+        {
+
+            m_retrying = true;
+            const uint delay = nextRetryDelay();
+            m_display.post("[Client]: Trying again in " + std::to_string((delay + 500) / 1000) + " seconds.");
+            m_retryTimer.expires_from_now(boost::posix_time::milliseconds(delay));
+            m_retryTimer.async_wait(boost::bind(&Client::handleRetryTimer, this, boost::asio::placeholders::error));
+
+        }
+
+        // HandleRetryTimer(error) is a callback for m_retryTimer. Once reconnected, it resumes reading, and writes whatever was
+        // queued meanwhile.
+        void handleRetryTimer(const boost::system::error_code& error)
+        {
+
+            if(error) { return; }
+
+            if(!reconnect())
+            {
+
+                if(m_numRetries < MAX_RETRIES) { scheduleRetry(); }
+                else { disconnect(); }
+
+                return;
+
+            }
+
+            startAsyncRead();
+
+            if(!m_writeScheduled.exchange(true)) { m_ioService.post(boost::bind(&Client::flushSendQueue, this)); }
+
+        }
+
+        // RunIoService() is the body of m_ioThread.
+        void runIoService()
+        {
+
+            m_ioService.run();
+
+        }
+
+        // StartAsyncRead() starts reading the next bytes from the server on m_ioThread.
+        void startAsyncRead()
+        {
+
+            getSession()->asyncReadSome(boost::asio::buffer(m_readChunk), boost::bind(&Client::handleAsyncRead, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+
+        }
+
+        // HandleAsyncRead(error, numBytes) is a callback for the result of startAsyncRead().
+        void handleAsyncRead(const boost::system::error_code& error, size_t numBytes)
+        {
+
+            if(error)
+            {
+
+                if(m_retryAfterMs != 0 && m_numRetries < MAX_RETRIES) { scheduleRetry(); }
+                else { disconnect(); }
+
+                return;
+
+            }
+
+            handleReceivedBytes(m_readChunk, numBytes);
+            startAsyncRead();
+
+        }
+
+        // QueueSend(packet) queues packet for m_ioThread to write, and schedules a flush unless one is already pending. It
+        // never blocks, and may be called from any thread.
+        void queueSend(const string& packet)
+        {
+
+            m_sendQueue.push(new string(packet));
+
+            if(!m_writeScheduled.exchange(true))
+            {
+
+                m_ioService.post(boost::bind(&Client::flushSendQueue, this));
+
+            }
+        }
+
+        // FlushSendQueue() coalesces the queued packets into a single write. It only runs on m_ioThread, one at a time, so
+        // every packet queued while a write is in progress goes out with the next one.
+        void flushSendQueue()
+        {
+
+            string* packet;
+
+            while(m_writeBuffer.length() < MAX_COALESCED_BYTES && m_sendQueue.pop(packet))
+            {
+
+                m_writeBuffer += *packet;
+                delete packet;
+
+            }
+
+            if(m_writeBuffer.empty())
+            {
+
+                m_writeScheduled = false;
+
+                // A packet queued after the last pop, but before the flag was cleared, did not schedule a flush of its own.
+                if(!m_sendQueue.empty() && !m_writeScheduled.exchange(true))
+                {
+
+                    m_ioService.post(boost::bind(&Client::flushSendQueue, this));
+
+                }
+
+                return;
+
+            }
+
+            getSession()->asyncWrite(boost::asio::buffer(m_writeBuffer), boost::bind(&Client::handleAsyncWrite, this, boost::asio::placeholders::error));
+
+        }
+
+        // HandleAsyncWrite(error) is a callback for the result of the write started by flushSendQueue(), which always writes
+        // all of m_writeBuffer or fails.
+        void handleAsyncWrite(const boost::system::error_code& error)
+        {
+
+            m_writeBuffer.clear();
+
+            if(error)
+            {
+
+                // The connection of a client that is about to try again is closed on purpose; the next one flushes the queue.
+                if(m_retrying || m_retryAfterMs != 0) { m_writeScheduled = false; }
+                else { disconnect(); }
+
+                return;
+
+            }
+
+            flushSendQueue();
 
         }
 
@@ -100,19 +499,47 @@ class Client
         Client(const Client&& rhs) = delete;
         Client& operator=(const Client&& rhs) = delete;
 
-        // Two-parameter constructor that initializes all properties of this Client object.
-        explicit Client(const string& host, const uint& port, const string& nickname) : m_hostName{host}, m_portNum{port}, m_nickname{nickname}, m_tcpSocket{nullptr} {}
+        // Three-parameter constructor that initializes all properties of this Client object. If useSharedMemory is set and host
+        // is a Unix domain socket path, packets are exchanged through a shared-memory ring pair. If async is set, the transport
+        // is driven by a worker thread and sendParamToServer(..) never blocks; this mode does not support shared memory.
+        explicit Client(const string& host, const uint& port, const string& nickname, const bool& useSharedMemory = false, const bool& async = false) : m_hostName{host}, m_portNum{port}, m_nickname{nickname}, m_connected{false}, m_useSharedMemory{useSharedMemory && !async}, m_async{async}, m_session{nullptr}, m_files{boost::bind(&Client::sendPacket, this, boost::placeholders::_1, boost::placeholders::_2), boost::bind(&TerminalRenderer::post, &m_display, boost::placeholders::_1)}, m_retryAfterMs{0}, m_retrying{false}, m_numRetries{0}, m_random{std::random_device{}()}, m_retryTimer{m_ioService}, m_sendQueue{SEND_QUEUE_CAPACITY}, m_writeScheduled{false} {}
 
-        // Destructor to cleanup memory in relation to m_tcpSocket.
+        // Destructor to cleanup memory in relation to m_session.
         ~Client()
         {
 
-            if(m_tcpSocket.get() != nullptr)
+            if(m_ioThread.joinable())
             {
 
-                m_tcpSocket.reset();
+                m_work.reset();
+                m_ioService.stop();
+
+                if(m_ioThread.get_id() != boost::this_thread::get_id()) { m_ioThread.join(); }
 
             }
+
+            string* packet;
+
+            while(m_sendQueue.pop(packet)) { delete packet; }
+
+            setSession(nullptr);
+        }
+
+        // SetFrameHandler(handler) hands every inbound packet other than pings to handler, instead of printing it. In
+        // asynchronous mode handler runs on the worker thread. Set it before connect().
+        void setFrameHandler(const FrameHandler& handler)
+        {
+
+            m_frameHandler = handler;
+
+        }
+
+        // GetDisplay() returns the renderer that displays inbound packets, and holds their scrollback.
+        inline TerminalRenderer& getDisplay() noexcept
+        {
+
+            return m_display;
+
         }
 
         // Connect() trys to establish a TCP Connection at host, m_hostName, and port, m_portNum.
@@ -122,17 +549,29 @@ class Client
             try
             {
                 
-                io_service ios;
-                m_tcpSocket.reset(new tcp::socket{ios});
-                m_tcpSocket->connect(tcp::endpoint(boost::asio::ip::address::from_string(m_hostName), m_portNum));
-                cout << "Client successfully connected to [" << m_hostName << ", " << m_portNum << "]" << endl;
+                openSession();
                 m_connected = true;
 
+                if(!m_frameHandler) { m_display.start(); }
+
                 // We need to let the server know what the nickname of this Client is. So send a packet with this information.
                 boost::system::error_code param_error;
                 sendParamToServer(m_nickname + ";", PacketTagTypes::PKT_NICKNAME, param_error);
 
-                boost::thread syncReadThread{boost::bind(&Client::startPacketRead, this)};
+                if(m_async)
+                {
+
+                    startAsyncRead();
+                    m_work.reset(new io_service::work{m_ioService});
+                    m_ioThread = boost::thread{boost::bind(&Client::runIoService, this)};
+
+                }
+                else
+                {
+
+                    boost::thread syncReadThread{boost::bind(&Client::startPacketRead, this)};
+
+                }
 
             }
             catch(const std::exception& e)
@@ -151,13 +590,18 @@ class Client
             try
             {
 
-                if(m_tcpSocket.get() != nullptr && isConnected())
+                const boost::shared_ptr<Session> session = getSession();
+
+                if(session.get() != nullptr && isConnected())
                 {
 
-                    m_tcpSocket->close();
+                    session->close();
+                    m_display.stop();
                     cout << "[Client]: Connection to server lost." << endl;
                     m_connected = false;
-                    exit(0);
+
+                    // An embedding application decides for itself what to do once the connection is lost.
+                    if(!m_async) { exit(0); }
 
                 }
             }
@@ -170,19 +614,36 @@ class Client
         }
 
         // SendParamToServer(message, tag, error) synchronously writes a concatenated buffer of (message + tag) to
-        // the server socket. If an error occurs, it will be stored in error.
+        // the server socket. If an error occurs, it will be stored in error. In asynchronous mode the packet is only
+        // queued, and a lost connection is reported through isConnected() instead.
         void sendParamToServer(const string& message, const string& tag, boost::system::error_code& error)
         {
 
             // If this socket is inactive, it cannot possibly receive any incoming packets.
             // So we check to be sure.
-            if(m_tcpSocket.get() == nullptr || !isConnected()) { return; }
+            if(getSession().get() == nullptr || !isConnected()) { return; }
+
+            // The server turned this client away, and it has not reconnected yet.
+            if(m_retrying) { return; }
+
+            if(m_async)
+            {
+
+                queueSend(tag + message);
+                return;
+
+            }
 
             try
             {
 
                 // Attempt to synchronously write to the server with a message of: tag + message.
-                boost::asio::write(*m_tcpSocket, boost::asio::buffer(tag + message), error);
+                {
+
+                    boost::lock_guard<boost::mutex> lock{m_writeMutex};
+                    getSession()->write(boost::asio::buffer(tag + message), error);
+
+                }
 
                 // Check if an error occurred during socket write, if so we lost connection, so we can clean up
                 // our resources on part of the client.
@@ -198,6 +659,14 @@ class Client
 
         }
 
+        // GetFileTransfers() returns the file transfers of this Client object, to offer, accept and decline files through.
+        FileTransferAgent& getFileTransfers() noexcept
+        {
+
+            return m_files;
+
+        }
+
         // GetHostName() returns the host name of this Client object.
         const string inline getHostName() const noexcept
         {
@@ -222,6 +691,22 @@ class Client
 
         }
 
+        // IsAsync() returns true if this Client object runs in asynchronous mode.
+        inline bool isAsync() const noexcept
+        {
+
+            return m_async;
+
+        }
+
+        // IsLocal() returns true if m_hostName is a Unix domain socket path rather than an IP address.
+        inline bool isLocal() const noexcept
+        {
+
+            return !m_hostName.empty() && m_hostName[0] == '/';
+
+        }
+
         // IsConnected() returns the connection status of this Client object.
         const bool inline isConnected() const noexcept
         {
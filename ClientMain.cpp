@@ -14,10 +14,22 @@ using std::endl;
 int main(int argc, char* argv[])
 {
 
-    if(argc != 4)
+    bool useSharedMemory = false;
+    bool async = false;
+
+    for(int index = 4; index < argc; index++)
+    {
+
+        if(string(argv[index]) == "shm") { useSharedMemory = true; }
+        else if(string(argv[index]) == "async") { async = true; }
+        else { argc = 0; }
+
+    }
+
+    if(argc < 4)
     {
 
-        cerr << "Usage: <host> <port> <nickname>" << endl;
+        cerr << "Usage: <host | local socket path> <port> <nickname> [shm] [async]" << endl;
         return 1;
 
     }
@@ -28,15 +40,48 @@ int main(int argc, char* argv[])
     std::vector<Parameter> privateMessageParams;
     privateMessageParams.push_back(Parameter("pm_user"));
     privateMessageParams.push_back(Parameter("pm_content"));
-    Command privateMessage{CommandNames::PRIV_MSG, privateMessageParams, "<user> <message>", 2};
+    Command privateMessage{CommandNames::PRIV_MSG, privateMessageParams, "<user> <message>", 2, PacketTagTypes::PKT_PM};
+
+    // Message search command.
+    std::vector<Parameter> searchParams;
+    searchParams.push_back(Parameter("search_terms"));
+    Command search{CommandNames::SEARCH, searchParams, "<terms>", 1, PacketTagTypes::PKT_SEARCH};
+
+    // File transfer commands.
+    std::vector<Parameter> sendFileParams;
+    sendFileParams.push_back(Parameter("file_user"));
+    sendFileParams.push_back(Parameter("file_path"));
+    Command sendFile{CommandNames::SEND_FILE, sendFileParams, "<user> <path>", 2, PacketTagTypes::PKT_FILE_OFFER};
+    std::vector<Parameter> transferParams;
+    transferParams.push_back(Parameter("transfer_id"));
+    Command acceptFile{CommandNames::ACCEPT_FILE, transferParams, "<transfer id>", 1, PacketTagTypes::PKT_FILE_ACCEPT};
+    Command declineFile{CommandNames::DECLINE_FILE, transferParams, "<transfer id>", 1, PacketTagTypes::PKT_FILE_COMPLETE};
+
+    // Ignore list commands.
+    std::vector<Parameter> ignoreParams;
+    ignoreParams.push_back(Parameter("ignore_user"));
+    Command ignore{CommandNames::IGNORE, ignoreParams, "<user>", 1, PacketTagTypes::PKT_IGNORE};
+    Command unignore{CommandNames::UNIGNORE, ignoreParams, "<user>", 1, PacketTagTypes::PKT_UNIGNORE};
+
+    // Scrollback command. It is handled by the client, so it has no packet tag.
+    std::vector<Parameter> historyParams;
+    historyParams.push_back(Parameter("history_count"));
+    Command history{CommandNames::HISTORY, historyParams, "<count>", 1, ""};
 
     // Append to CommandManager instance.
     CommandManager::getInstance().addCommand(privateMessage);
+    CommandManager::getInstance().addCommand(search);
+    CommandManager::getInstance().addCommand(sendFile);
+    CommandManager::getInstance().addCommand(acceptFile);
+    CommandManager::getInstance().addCommand(declineFile);
+    CommandManager::getInstance().addCommand(ignore);
+    CommandManager::getInstance().addCommand(unignore);
+    CommandManager::getInstance().addCommand(history);
 
     // Pass executable arguments to Client object.
     char* port_ptr;
     cout << argv[0] << endl;
-    Client client{argv[1], static_cast<unsigned int>(strtol(argv[2], &port_ptr, 10)), argv[3]};
+    Client client{argv[1], static_cast<unsigned int>(strtol(argv[2], &port_ptr, 10)), argv[3], useSharedMemory, async};
     client.connect();
 
     // Block while client is connected to TCP server.
@@ -84,11 +129,43 @@ int main(int argc, char* argv[])
 
                     }
 
+                }
+                else if(name == CommandNames::SEND_FILE)
+                {
+
+                    // File transfers are driven by the client, which reads the file as the recipient takes it.
+                    const string& args = input.substr(nameEndIndex + 1);
+                    const size_t pathStart = args.find(' ');
+
+                    if(pathStart == string::npos || !client.getFileTransfers().offer(args.substr(0, pathStart), args.substr(pathStart + 1)))
+                    {
+
+                        cout << "[File]: Unable to open '" << (pathStart == string::npos ? args : args.substr(pathStart + 1)) << "'." << endl;
+
+                    }
+                }
+                else if(name == CommandNames::ACCEPT_FILE || name == CommandNames::DECLINE_FILE)
+                {
+
+                    const uint32_t id = static_cast<uint32_t>(strtoul(input.c_str() + nameEndIndex + 1, nullptr, 10));
+                    const bool found = name == CommandNames::ACCEPT_FILE ? client.getFileTransfers().accept(id) : client.getFileTransfers().decline(id);
+
+                    if(!found) { cout << "[File]: There is no file transfer " << id << "." << endl; }
+
+                }
+                else if(name == CommandNames::HISTORY)
+                {
+
+                    // Redisplay recent messages, including those collapsed during a burst.
+                    client.getDisplay().showHistory(strtoul(input.c_str() + nameEndIndex + 1, nullptr, 10));
+
                 }
                 else
                 {
 
-                    client.sendParamToServer(input.substr(nameEndIndex + 1) + ";", PacketTagTypes::PKT_PM, ec);
+                    // Send the command input with the packet tag of the command.
+                    const string& tag = CommandManager::getInstance().getParameterListOf(name).first.getPacketTag();
+                    client.sendParamToServer(input.substr(nameEndIndex + 1) + ";", tag, ec);
 
                 }
             }
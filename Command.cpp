@@ -14,15 +14,17 @@ class Command
         std::vector<Parameter> m_parameters; // A vector of Parameter objects that represent the possibly parameters for this command.
         unsigned short m_numRequiredParams; // The number of Parameter objects marked as required inside m_parameters.
         std::string m_commandUsage; // A string literal that describes the abstract usage of this Command object.
+        std::string m_packetTag; // The packet tag (@see PacketTagTypes) that the input of this Command object is sent to the server with.
 
     public:
 
-        // Two-parameter constructor that accepts a command name and list of Parameter objects for that command.
-        Command(const std::string& name, const std::vector<Parameter>& params, const std::string& usage, const unsigned short& nrp) noexcept : m_commandName{name}, m_parameters{params}, m_commandUsage{usage}, m_numRequiredParams{nrp} {}
+        // Five-parameter constructor that accepts a command name, list of Parameter objects for that command, and the packet
+        // tag its input is sent with.
+        Command(const std::string& name, const std::vector<Parameter>& params, const std::string& usage, const unsigned short& nrp, const std::string& packetTag) noexcept : m_commandName{name}, m_parameters{params}, m_commandUsage{usage}, m_numRequiredParams{nrp}, m_packetTag{packetTag} {}
 
-        // One-parameter constructor that accepts a command name and initializes m_parameters to an empty list. This is useful
+        // Three-parameter constructor that accepts a command name and initializes m_parameters to an empty list. This is useful
         // if you would like to manually add parameters using the addParameter(..) method.
-        explicit Command(const std::string& name, const std::string& usage) noexcept : m_commandName{name}, m_commandUsage{usage}, m_numRequiredParams{0} {}
+        explicit Command(const std::string& name, const std::string& usage, const std::string& packetTag) noexcept : m_commandName{name}, m_commandUsage{usage}, m_numRequiredParams{0}, m_packetTag{packetTag} {}
 
         // Default destructor.
         ~Command() {}
@@ -72,4 +74,12 @@ class Command
             return m_commandUsage;
 
         }
+
+        // GetPacketTag() returns the packet tag that the input of this Command object is sent with; m_packetTag.
+        inline const std::string getPacketTag() const noexcept
+        {
+
+            return m_packetTag;
+
+        }
 };
\ No newline at end of file
@@ -84,7 +84,7 @@ class CommandManager
             }
 
             // No match found. Return empty pair.
-            return std::pair<Command, std::vector<Parameter>>(Command("", ""), std::vector<Parameter>());
+            return std::pair<Command, std::vector<Parameter>>(Command("", "", ""), std::vector<Parameter>());
 
         }
 
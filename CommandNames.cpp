@@ -14,5 +14,12 @@ class CommandNames
 
         // Command names.
         inline static const std::string PRIV_MSG{"pm"};
+        inline static const std::string SEARCH{"search"};
+        inline static const std::string SEND_FILE{"send"};
+        inline static const std::string ACCEPT_FILE{"accept"};
+        inline static const std::string DECLINE_FILE{"decline"};
+        inline static const std::string IGNORE{"ignore"};
+        inline static const std::string UNIGNORE{"unignore"};
+        inline static const std::string HISTORY{"history"};
 
 };
\ No newline at end of file
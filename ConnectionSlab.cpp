@@ -0,0 +1,432 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+// USER DEFINED IMPORTS
+#include "Session.cpp"
+#include "OutboundQueue.cpp"
+#include "CpuTopology.cpp"
+
+using std::string;
+
+// ConnectionHandle refers to a ConnectionSlot by index, and is only honoured while the slot's generation still matches.
+// Once a connection is released, every outstanding handle to it becomes stale instead of dangling.
+struct ConnectionHandle
+{
+
+    uint32_t index;
+    uint32_t generation;
+
+    ConnectionHandle() noexcept : index{UINT32_MAX}, generation{0} {}
+    ConnectionHandle(uint32_t index_, uint32_t generation_) noexcept : index{index_}, generation{generation_} {}
+
+    inline bool isValid() const noexcept { return index != UINT32_MAX; }
+    inline bool operator==(const ConnectionHandle& rhs) const noexcept { return index == rhs.index && generation == rhs.generation; }
+    inline bool operator!=(const ConnectionHandle& rhs) const noexcept { return !(*this == rhs); }
+
+};
+
+// ConnectionSlot is the complete per-connection state of the server, stored inline in a preallocated ConnectionSlab.
+struct ConnectionSlot
+{
+
+    inline static const size_t MAX_NICKNAME_LENGTH = 31; // Nicknames are stored inline, so their length is bounded.
+
+    std::atomic<uint32_t> generation; // Bumped every time this slot is released; invalidates outstanding handles.
+    std::atomic<bool> inUse; // True while a connection occupies this slot. Read without a lock by fanout shards.
+    std::atomic<bool> joined; // True once the connection has sent its nickname. Read without a lock by fanout shards.
+    uint8_t nicknameLength; // The length of nickname.
+    char nickname[MAX_NICKNAME_LENGTH + 1]; // The nickname of the connection, NUL terminated.
+    uint32_t connectionId; // The id the server assigned to this connection; used by traffic captures.
+    Session* session; // The transport of this connection. Owned by this slot.
+    char* ioBuffer; // Received bytes that do not yet form a complete frame. Only allocated while such bytes exist.
+    uint32_t ioBufferCapacity; // The capacity of ioBuffer.
+    uint32_t ioBufferLength; // The number of bytes held in ioBuffer.
+    uint32_t ioBufferNode; // The NUMA node ioBuffer was allocated on.
+    OutboundQueue* outbound; // Frames the transport could not take yet. Only allocated while such frames exist; owned by the fanout shard of this slot.
+
+    ConnectionSlot() noexcept : generation{0}, inUse{false}, joined{false}, nicknameLength{0}, nickname{}, connectionId{0}, session{nullptr}, ioBuffer{nullptr}, ioBufferCapacity{0}, ioBufferLength{0}, ioBufferNode{0}, outbound{nullptr} {}
+
+    // GetNickname() returns the nickname of this slot.
+    inline string getNickname() const
+    {
+
+        return string(nickname, nicknameLength);
+
+    }
+
+    // SetNickname(name) stores name inline. It returns false if name is longer than MAX_NICKNAME_LENGTH.
+    bool setNickname(const string& name) noexcept
+    {
+
+        if(name.length() > MAX_NICKNAME_LENGTH) { return false; }
+
+        memcpy(nickname, name.data(), name.length());
+        nickname[name.length()] = '\0';
+        nicknameLength = static_cast<uint8_t>(name.length());
+        return true;
+
+    }
+};
+
+// ConnectionMemoryStats is a breakdown of the memory the server spends on its connections (@see Server::getConnectionMemoryStats()).
+struct ConnectionMemoryStats
+{
+
+    uint32_t numConnections; // The number of occupied slots.
+    uint32_t slabCapacity; // The number of preallocated slots.
+    size_t slabBytes; // The memory preallocated for every slot, occupied or not.
+    size_t slotBytes; // The share of slabBytes used by occupied slots.
+    size_t ioBufferBytes; // Receive buffers currently held by connections.
+    size_t pooledBufferBytes; // Idle receive buffers kept for reuse.
+    size_t outboundBytes; // Frames queued for connections that could not take them yet. Shared frames are counted once per connection.
+    size_t sessionBytes; // Transport objects (sockets, shared-memory rings).
+    size_t stackBytes; // Stacks reserved by reader threads, one per connection. Not in bytesPerConnection (@see stackBytesPerConnection).
+    size_t logBufferBytes; // The log ring every reader thread shares, whatever the number of connections (@see Logger::shareBuffer()).
+    size_t bytesPerConnection; // (slotBytes + ioBufferBytes + outboundBytes + sessionBytes) / numConnections: the state of a connection.
+    size_t stackBytesPerConnection; // stackBytes / numConnections: the address space each reader thread reserves on top, of which only the pages it touches are resident.
+
+};
+
+// ConnectionSlab is a preallocated array of ConnectionSlot objects together with a pool of receive buffers. Slots are
+// recycled through a free list and referred to by generation-checked ConnectionHandle values.
+//
+// Receive buffers are pooled per NUMA node. A reader thread takes its buffers from the pool of the node it runs on, and
+// fresh buffers are first written by that thread, so the kernel places their pages on its node too. Released buffers go
+// back to the pool of the node they were taken for, so a buffer never migrates to a reader on another node.
+//
+// Allocation and release are thread-safe. The fields of an occupied slot are not; callers serialise access to them.
+class ConnectionSlab
+{
+
+    public:
+
+        inline static const uint32_t IO_BUFFER_SIZE = 4096; // The size of a pooled receive buffer.
+        inline static const uint32_t MAX_IO_BUFFER_SIZE = 1 << 20; // A connection whose pending frame outgrows this is dropped.
+        inline static const size_t MAX_POOLED_BUFFERS = 1024; // The most idle receive buffers kept for reuse, per NUMA node.
+
+    private:
+
+        std::unique_ptr<ConnectionSlot[]> m_slots; // The slots themselves.
+        uint32_t m_capacity; // The number of slots in m_slots.
+        std::vector<uint32_t> m_freeIndices; // Released slot indices, reused before m_highWater grows.
+        std::atomic<uint32_t> m_highWater; // One past the highest index ever handed out; iteration stops here.
+        std::atomic<uint32_t> m_numInUse; // The number of occupied slots.
+        std::vector<std::vector<char*>> m_bufferPools; // Idle receive buffers of IO_BUFFER_SIZE bytes, by NUMA node.
+        std::atomic<size_t> m_ioBufferBytes; // The bytes of receive buffer currently held by slots.
+        std::atomic<size_t> m_outboundBytes; // The bytes queued in the OutboundQueue of every slot.
+        boost::mutex m_mutex; // Guards m_freeIndices and m_bufferPools.
+
+        // FreeIoBuffer(slot) hands the receive buffer of slot back to the pool, or to the heap if the pool is full.
+        void freeIoBuffer(ConnectionSlot& slot)
+        {
+
+            if(slot.ioBuffer == nullptr) { return; }
+
+            m_ioBufferBytes -= slot.ioBufferCapacity;
+
+            if(slot.ioBufferCapacity == IO_BUFFER_SIZE)
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+
+                if(m_bufferPools[slot.ioBufferNode].size() < MAX_POOLED_BUFFERS)
+                {
+
+                    m_bufferPools[slot.ioBufferNode].push_back(slot.ioBuffer);
+                    slot.ioBuffer = nullptr;
+
+                }
+            }
+
+            delete[] slot.ioBuffer;
+            slot.ioBuffer = nullptr;
+            slot.ioBufferCapacity = 0;
+            slot.ioBufferLength = 0;
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        ConnectionSlab(const ConnectionSlab& rhs) = delete;
+        ConnectionSlab& operator=(const ConnectionSlab& rhs) = delete;
+
+        // One-parameter constructor that preallocates capacity slots.
+        explicit ConnectionSlab(uint32_t capacity) : m_slots{new ConnectionSlot[capacity]}, m_capacity{capacity}, m_highWater{0}, m_numInUse{0}, m_bufferPools(CpuTopology::getInstance().getNumNodes()), m_ioBufferBytes{0}, m_outboundBytes{0} {}
+
+        // Destructor that releases every occupied slot and pooled buffer.
+        ~ConnectionSlab()
+        {
+
+            for(uint32_t index = 0; index < m_highWater; index++)
+            {
+
+                ConnectionSlot& slot = m_slots[index];
+                delete slot.session;
+                delete[] slot.ioBuffer;
+                delete slot.outbound;
+
+            }
+
+            for(const std::vector<char*>& pool : m_bufferPools)
+            {
+
+                for(char* buffer : pool) { delete[] buffer; }
+
+            }
+        }
+
+        // Allocate(session, connectionId) places a new connection in a free slot, taking ownership of session. It returns
+        // an invalid handle (and leaves session with the caller) if every slot is occupied.
+        ConnectionHandle allocate(Session* session, uint32_t connectionId)
+        {
+
+            uint32_t index;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+
+                if(!m_freeIndices.empty())
+                {
+
+                    index = m_freeIndices.back();
+                    m_freeIndices.pop_back();
+
+                }
+                else if(m_highWater < m_capacity)
+                {
+
+                    index = m_highWater;
+
+                }
+                else
+                {
+
+                    return ConnectionHandle{};
+
+                }
+
+                ConnectionSlot& slot = m_slots[index];
+                slot.inUse = true;
+                slot.joined = false;
+                slot.nicknameLength = 0;
+                slot.nickname[0] = '\0';
+                slot.connectionId = connectionId;
+                slot.session = session;
+
+                // Publish the slot to iterating threads only once it is fully initialised.
+                if(index == m_highWater) { m_highWater.store(index + 1, std::memory_order_release); }
+
+            }
+
+            m_numInUse++;
+            return ConnectionHandle{index, m_slots[index].generation.load(std::memory_order_acquire)};
+
+        }
+
+        // Release(handle) frees the slot of handle, closing and deleting its session and returning its receive buffer. Every
+        // handle to the slot becomes stale. Only called once the reader thread of the slot has stopped using the session.
+        void release(const ConnectionHandle& handle)
+        {
+
+            ConnectionSlot* slot = get(handle);
+
+            if(slot == nullptr) { return; }
+
+            freeIoBuffer(*slot);
+            destroyOutboundQueue(*slot);
+            if(slot->session != nullptr) { slot->session->close(); }
+
+            delete slot->session;
+            slot->session = nullptr;
+            slot->joined = false;
+            slot->inUse = false;
+            slot->generation.fetch_add(1, std::memory_order_acq_rel);
+            m_numInUse--;
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            m_freeIndices.push_back(handle.index);
+
+        }
+
+        // Get(handle) returns the slot of handle, or nullptr if handle is stale.
+        inline ConnectionSlot* get(const ConnectionHandle& handle) noexcept
+        {
+
+            if(handle.index >= m_capacity) { return nullptr; }
+
+            ConnectionSlot& slot = m_slots[handle.index];
+            return slot.inUse && slot.generation.load(std::memory_order_acquire) == handle.generation ? &slot : nullptr;
+
+        }
+
+        // At(index) returns the slot at index, occupied or not.
+        inline ConnectionSlot& at(uint32_t index) noexcept
+        {
+
+            return m_slots[index];
+
+        }
+
+        // HandleOf(index) returns a handle to the current occupant of the slot at index.
+        inline ConnectionHandle handleOf(uint32_t index) const noexcept
+        {
+
+            return ConnectionHandle{index, m_slots[index].generation.load(std::memory_order_acquire)};
+
+        }
+
+        // GetHighWater() returns one past the highest slot index that has ever been occupied.
+        inline uint32_t getHighWater() const noexcept
+        {
+
+            return m_highWater.load(std::memory_order_acquire);
+
+        }
+
+        // GetNumInUse() returns the number of occupied slots.
+        inline uint32_t getNumInUse() const noexcept
+        {
+
+            return m_numInUse.load(std::memory_order_relaxed);
+
+        }
+
+        // GetOutboundBytes() returns the bytes queued for every connection that could not take them yet.
+        inline size_t getOutboundBytes() const noexcept
+        {
+
+            return m_outboundBytes.load(std::memory_order_relaxed);
+
+        }
+
+        // GetCapacity() returns the number of preallocated slots.
+        inline uint32_t getCapacity() const noexcept
+        {
+
+            return m_capacity;
+
+        }
+
+        // ReserveIoBuffer(slot, minFree) makes sure the receive buffer of slot has at least minFree bytes free after its
+        // pending bytes, allocating it lazily from the NUMA node of the calling thread. It returns nullptr if the buffer
+        // would outgrow MAX_IO_BUFFER_SIZE.
+        char* reserveIoBuffer(ConnectionSlot& slot, uint32_t minFree)
+        {
+
+            if(slot.ioBuffer == nullptr)
+            {
+
+                slot.ioBufferNode = CpuTopology::getInstance().currentNode();
+
+                {
+
+                    boost::lock_guard<boost::mutex> lock{m_mutex};
+                    std::vector<char*>& pool = m_bufferPools[slot.ioBufferNode];
+
+                    if(!pool.empty())
+                    {
+
+                        slot.ioBuffer = pool.back();
+                        pool.pop_back();
+
+                    }
+                }
+
+                if(slot.ioBuffer == nullptr) { slot.ioBuffer = new char[IO_BUFFER_SIZE]; }
+
+                slot.ioBufferCapacity = IO_BUFFER_SIZE;
+                slot.ioBufferLength = 0;
+                m_ioBufferBytes += IO_BUFFER_SIZE;
+
+            }
+
+            if(slot.ioBufferCapacity - slot.ioBufferLength < minFree)
+            {
+
+                uint32_t capacity = slot.ioBufferCapacity;
+
+                while(capacity - slot.ioBufferLength < minFree) { capacity *= 2; }
+
+                if(capacity > MAX_IO_BUFFER_SIZE) { return nullptr; }
+
+                char* grown = new char[capacity];
+                memcpy(grown, slot.ioBuffer, slot.ioBufferLength);
+                const uint32_t length = slot.ioBufferLength;
+                freeIoBuffer(slot);
+                slot.ioBuffer = grown;
+                slot.ioBufferCapacity = capacity;
+                slot.ioBufferLength = length;
+                m_ioBufferBytes += capacity;
+
+            }
+
+            return slot.ioBuffer + slot.ioBufferLength;
+
+        }
+
+        // Consume(slot, numBytes) discards the first numBytes of the receive buffer of slot, and releases the buffer
+        // altogether once nothing is pending, so an idle connection holds no receive buffer.
+        void consume(ConnectionSlot& slot, uint32_t numBytes)
+        {
+
+            if(numBytes < slot.ioBufferLength)
+            {
+
+                memmove(slot.ioBuffer, slot.ioBuffer + numBytes, slot.ioBufferLength - numBytes);
+                slot.ioBufferLength -= numBytes;
+                return;
+
+            }
+
+            freeIoBuffer(slot);
+
+        }
+
+        // CreateOutboundQueue(slot) gives slot an empty OutboundQueue, accounted for by this ConnectionSlab, and returns it.
+        OutboundQueue& createOutboundQueue(ConnectionSlot& slot)
+        {
+
+            if(slot.outbound == nullptr) { slot.outbound = new OutboundQueue{&m_outboundBytes}; }
+
+            return *slot.outbound;
+
+        }
+
+        // DestroyOutboundQueue(slot) discards the OutboundQueue of slot, if it has one.
+        void destroyOutboundQueue(ConnectionSlot& slot)
+        {
+
+            delete slot.outbound;
+            slot.outbound = nullptr;
+
+        }
+
+        // GetMemoryStats() returns the memory held by the slab. Session, stack and log ring usage are left for the caller to fill in.
+        ConnectionMemoryStats getMemoryStats()
+        {
+
+            ConnectionMemoryStats stats{};
+            stats.numConnections = m_numInUse.load();
+            stats.slabCapacity = m_capacity;
+            stats.slabBytes = sizeof(ConnectionSlot) * m_capacity;
+            stats.slotBytes = sizeof(ConnectionSlot) * stats.numConnections;
+            stats.ioBufferBytes = m_ioBufferBytes.load();
+            stats.outboundBytes = m_outboundBytes.load();
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            for(const std::vector<char*>& pool : m_bufferPools) { stats.pooledBufferBytes += pool.size() * IO_BUFFER_SIZE; }
+
+            return stats;
+
+        }
+};
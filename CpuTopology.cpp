@@ -0,0 +1,232 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <boost/thread.hpp>
+
+using std::string;
+
+// CpuSet is a sorted list of CPU numbers.
+typedef std::vector<uint32_t> CpuSet;
+
+// CpuTopology describes the CPUs of the host and the NUMA node each belongs to, as reported under /sys. Hosts without
+// NUMA information are treated as a single node holding every CPU.
+class CpuTopology
+{
+
+    private:
+
+        CpuSet m_onlineCpus; // Every CPU that is online.
+        std::vector<uint32_t> m_nodeOf; // The node of each CPU, indexed by CPU number.
+        uint32_t m_numNodes; // The number of NUMA nodes.
+
+        // ReadLine(path) returns the first line of the file at path, or an empty string if it cannot be read.
+        static string readLine(const string& path)
+        {
+
+            std::ifstream file{path};
+            string line;
+            std::getline(file, line);
+            return line;
+
+        }
+
+        // Default constructor that reads the topology of the host; hidden to enforce singleton use (@see getInstance()).
+        CpuTopology() : m_numNodes{1}
+        {
+
+            if(!parseCpuList(readLine("/sys/devices/system/cpu/online"), m_onlineCpus) || m_onlineCpus.empty())
+            {
+
+                m_onlineCpus.clear();
+
+                for(uint32_t cpu = 0; cpu < std::max(1u, boost::thread::hardware_concurrency()); cpu++) { m_onlineCpus.push_back(cpu); }
+
+            }
+
+            m_nodeOf.assign(m_onlineCpus.back() + 1, 0);
+            CpuSet nodes;
+
+            if(!parseCpuList(readLine("/sys/devices/system/node/online"), nodes)) { return; }
+
+            for(uint32_t node : nodes)
+            {
+
+                CpuSet cpus;
+
+                if(!parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"), cpus)) { continue; }
+
+                for(uint32_t cpu : cpus)
+                {
+
+                    if(cpu < m_nodeOf.size()) { m_nodeOf[cpu] = node; }
+
+                }
+
+                m_numNodes = std::max(m_numNodes, node + 1);
+
+            }
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        CpuTopology(const CpuTopology& rhs) = delete;
+        CpuTopology& operator=(const CpuTopology& rhs) = delete;
+
+        // GetInstance() is a singleton method that returns a static instance of this class. The topology is read once,
+        // on first use.
+        static CpuTopology& getInstance()
+        {
+
+            static CpuTopology inst;
+            return inst;
+
+        }
+
+        // ParseCpuList(text, cpus) parses text in the format of /sys CPU lists (ie: "0-3,8,10-11") into cpus. It returns
+        // false if text is not such a list, or names a CPU past CPU_SETSIZE.
+        static bool parseCpuList(const string& text, CpuSet& cpus)
+        {
+
+            cpus.clear();
+            size_t start = 0;
+
+            while(start < text.length())
+            {
+
+                size_t end = text.find(',', start);
+
+                if(end == string::npos) { end = text.length(); }
+
+                const string range = text.substr(start, end - start);
+                const size_t dash = range.find('-');
+                char* last;
+                const unsigned long first = strtoul(range.c_str(), &last, 10);
+                unsigned long final = first;
+
+                if(range.empty() || last == range.c_str() || (dash == string::npos ? *last != '\0' : last != range.c_str() + dash)) { return false; }
+
+                if(dash != string::npos)
+                {
+
+                    final = strtoul(range.c_str() + dash + 1, &last, 10);
+
+                    if(*last != '\0' || last == range.c_str() + dash + 1 || final < first) { return false; }
+
+                }
+
+                if(final >= CPU_SETSIZE) { return false; }
+
+                for(unsigned long cpu = first; cpu <= final; cpu++) { cpus.push_back(static_cast<uint32_t>(cpu)); }
+
+                start = end + 1;
+
+            }
+
+            std::sort(cpus.begin(), cpus.end());
+            cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+            return !cpus.empty();
+
+        }
+
+        // PinCurrentThread(cpus) restricts the calling thread to run on cpus. An empty cpus leaves the thread where it is. It
+        // returns false if the thread could not be pinned.
+        static bool pinCurrentThread(const CpuSet& cpus)
+        {
+
+            if(cpus.empty()) { return true; }
+
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+
+            for(uint32_t cpu : cpus)
+            {
+
+                if(cpu < CPU_SETSIZE) { CPU_SET(cpu, &mask); }
+
+            }
+
+            return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+
+        }
+
+        // IsOnline(cpu) returns true if cpu is online.
+        inline bool isOnline(uint32_t cpu) const noexcept
+        {
+
+            return std::binary_search(m_onlineCpus.begin(), m_onlineCpus.end(), cpu);
+
+        }
+
+        // NodeOf(cpu) returns the NUMA node of cpu.
+        inline uint32_t nodeOf(uint32_t cpu) const noexcept
+        {
+
+            return cpu < m_nodeOf.size() ? m_nodeOf[cpu] : 0;
+
+        }
+
+        // CurrentNode() returns the NUMA node of the CPU the calling thread is running on.
+        inline uint32_t currentNode() const noexcept
+        {
+
+            const int cpu = sched_getcpu();
+            return cpu < 0 ? 0 : nodeOf(static_cast<uint32_t>(cpu));
+
+        }
+
+        // GetNumNodes() returns the number of NUMA nodes.
+        inline uint32_t getNumNodes() const noexcept
+        {
+
+            return m_numNodes;
+
+        }
+
+        // GetOnlineCpus() returns every CPU that is online.
+        inline const CpuSet& getOnlineCpus() const noexcept
+        {
+
+            return m_onlineCpus;
+
+        }
+};
+
+// ThreadPlacement is the CPUs each kind of server thread is pinned to. An empty set leaves its threads to the scheduler.
+struct ThreadPlacement
+{
+
+    CpuSet acceptCpus; // The threads accepting connections.
+    CpuSet fanoutCpus; // The fanout shards; shard k runs on fanoutCpus[k % fanoutCpus.size()].
+    CpuSet readerCpus; // The threads reading from connections.
+
+    // ReaderCpusFor(incomingCpu) returns the CPUs the reader of a connection whose packets arrive on incomingCpu is pinned
+    // to: incomingCpu itself if it is a reader CPU, otherwise the reader CPUs on its NUMA node, otherwise every reader CPU.
+    // IncomingCpu is -1 if it is not known.
+    CpuSet readerCpusFor(int incomingCpu) const
+    {
+
+        if(incomingCpu < 0 || readerCpus.empty()) { return readerCpus; }
+
+        if(std::binary_search(readerCpus.begin(), readerCpus.end(), static_cast<uint32_t>(incomingCpu))) { return CpuSet{static_cast<uint32_t>(incomingCpu)}; }
+
+        const CpuTopology& topology = CpuTopology::getInstance();
+        CpuSet local;
+
+        for(uint32_t cpu : readerCpus)
+        {
+
+            if(topology.nodeOf(cpu) == topology.nodeOf(incomingCpu)) { local.push_back(cpu); }
+
+        }
+
+        return local.empty() ? readerCpus : local;
+
+    }
+};
@@ -0,0 +1,319 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+// USER DEFINED IMPORTS
+#include "ConnectionSlab.cpp"
+#include "OutboundQueue.cpp"
+#include "IgnoreTable.cpp"
+#include "CpuTopology.cpp"
+
+using std::string;
+
+// What a FanoutJob asks its shard to do.
+enum FanoutJobType : uint8_t
+{
+
+    FANOUT_BROADCAST, // Write message to every joined connection the shard owns, except exclude and those in mutedBy.
+    FANOUT_UNICAST, // Write message to target.
+    FANOUT_RELEASE // Release the slot of target. Done by the owning shard so nothing is writing to it at the time.
+
+};
+
+// FanoutJob is a unit of work queued on a shard. A broadcast shares one message between every shard it is queued on.
+struct FanoutJob
+{
+
+    FanoutJobType type;
+    boost::shared_ptr<const string> message;
+    ConnectionHandle target;
+    ConnectionHandle exclude;
+    OutboundClass priority;
+    uint32_t traceId = 0; // The LatencyTracer trace of message, or 0 if it is not traced.
+    IgnoreMaskPtr mutedBy{}; // The connections a broadcast skips, or null to skip none.
+
+};
+
+// FanoutPool splits outbound traffic across a fixed set of shard threads. Connection slot index i is owned by shard
+// (i % numShards), and only its owning shard ever writes to a connection, so the transports need no locking. Each shard
+// handles its jobs in FIFO order, which preserves the order of every sender's messages at every recipient.
+//
+// Small fanouts can skip the handoff with tryRunInline(..), which runs on the calling thread only while every shard
+// is idle; that keeps it ordered with respect to everything queued before it.
+//
+// A shard also retries writes its connections could not take yet: once a delivery backlogs a connection, the owner of
+// the pool calls requestFlush(..), and the shard keeps calling its flush function every flush retry interval until that
+// reports nothing is left.
+class FanoutPool
+{
+
+    public:
+
+        typedef boost::function<void(uint32_t shard, const FanoutJob& job)> DeliverFunction;
+        typedef boost::function<bool(uint32_t shard)> FlushFunction;
+
+        inline static const long DEFAULT_FLUSH_RETRY_MS = 2; // How often a shard with backlogged connections retries them, by default.
+
+    private:
+
+        // Shard is the queue and thread of a single shard.
+        struct Shard
+        {
+
+            boost::mutex mutex; // Guards queue.
+            boost::condition_variable wakeup; // Signalled when queue becomes non-empty or the pool stops.
+            std::deque<FanoutJob> queue; // Jobs not yet started.
+            std::atomic<bool> backlogged{false}; // True while a connection of this shard has writes left to retry.
+            boost::thread thread; // The thread that runs this shard.
+
+        };
+
+        uint32_t m_numShards; // The number of shards.
+        std::vector<Shard*> m_shards; // The shards; index k owns every slot index i where i % m_numShards == k.
+        DeliverFunction m_deliver; // Performs a job on behalf of a shard.
+        FlushFunction m_flush; // Retries the backlogged connections of a shard; returns true if some remain backlogged.
+        CpuSet m_cpus; // The CPUs the shards are pinned to, one each in turn, or empty to leave them unpinned.
+        std::atomic<bool> m_running; // The running status of the shard threads.
+        std::atomic<uint64_t> m_pendingJobs; // Jobs queued or in progress, across every shard.
+        std::atomic<long> m_flushRetryMs; // How often a shard with backlogged connections retries them.
+        boost::shared_mutex m_deliveryMutex; // Shards hold it shared while delivering; tryRunInline(..) holds it exclusively.
+
+        // RunShard(shard) is the body of the thread of shard. It takes every queued job at once and delivers them in order.
+        void runShard(uint32_t shard)
+        {
+
+            Shard& self = *m_shards[shard];
+            std::deque<FanoutJob> batch;
+
+            if(!m_cpus.empty()) { CpuTopology::pinCurrentThread(CpuSet{m_cpus[shard % m_cpus.size()]}); }
+
+            for(;;)
+            {
+
+                {
+
+                    boost::unique_lock<boost::mutex> lock{self.mutex};
+
+                    if(self.backlogged)
+                    {
+
+                        if(self.queue.empty() && m_running) { self.wakeup.timed_wait(lock, boost::posix_time::milliseconds(m_flushRetryMs.load(std::memory_order_relaxed))); }
+
+                    }
+                    else
+                    {
+
+                        while(self.queue.empty() && !self.backlogged && m_running) { self.wakeup.wait(lock); }
+
+                    }
+
+                    if(self.queue.empty() && !m_running) { return; }
+
+                    batch.swap(self.queue);
+
+                }
+
+                {
+
+                    boost::shared_lock<boost::shared_mutex> delivery{m_deliveryMutex};
+
+                    for(const FanoutJob& job : batch) { m_deliver(shard, job); }
+
+                    if(self.backlogged) { self.backlogged = m_flush(shard); }
+
+                }
+
+                m_pendingJobs -= batch.size();
+                batch.clear();
+
+            }
+        }
+
+        // Enqueue(shard, job) appends job to the queue of shard.
+        void enqueue(uint32_t shard, const FanoutJob& job)
+        {
+
+            Shard& target = *m_shards[shard];
+            bool wasEmpty;
+            m_pendingJobs++;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{target.mutex};
+                wasEmpty = target.queue.empty();
+                target.queue.push_back(job);
+
+            }
+
+            if(wasEmpty) { target.wakeup.notify_one(); }
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        FanoutPool(const FanoutPool& rhs) = delete;
+        FanoutPool& operator=(const FanoutPool& rhs) = delete;
+
+        // One-parameter constructor that creates numShards shards. No thread runs until start(..) is called.
+        explicit FanoutPool(uint32_t numShards) : m_numShards{numShards == 0 ? 1 : numShards}, m_running{false}, m_pendingJobs{0}, m_flushRetryMs{DEFAULT_FLUSH_RETRY_MS}
+        {
+
+            for(uint32_t shard = 0; shard < m_numShards; shard++) { m_shards.push_back(new Shard); }
+
+        }
+
+        // Destructor that stops the shard threads.
+        ~FanoutPool()
+        {
+
+            stop();
+
+            for(Shard* shard : m_shards) { delete shard; }
+
+        }
+
+        // Start(deliver, flush, cpus) starts one thread per shard. Each job is handed to deliver on the thread of its shard,
+        // and flush retries the backlogged connections of a shard (@see requestFlush(..)). Shard k is pinned to
+        // cpus[k % cpus.size()], so the outbound queues it allocates live on the NUMA node of that CPU; an empty cpus
+        // leaves the shards unpinned.
+        void start(const DeliverFunction& deliver, const FlushFunction& flush, const CpuSet& cpus = CpuSet{})
+        {
+
+            if(m_running.exchange(true)) { return; }
+
+            m_deliver = deliver;
+            m_flush = flush;
+            m_cpus = cpus;
+
+            for(uint32_t shard = 0; shard < m_numShards; shard++)
+            {
+
+                m_shards[shard]->thread = boost::thread{boost::bind(&FanoutPool::runShard, this, shard)};
+
+            }
+        }
+
+        // Stop() delivers every job already queued, then stops the shard threads.
+        void stop()
+        {
+
+            if(!m_running.exchange(false)) { return; }
+
+            for(Shard* shard : m_shards)
+            {
+
+                {
+
+                    boost::lock_guard<boost::mutex> lock{shard->mutex};
+
+                }
+
+                shard->wakeup.notify_all();
+
+            }
+
+            for(Shard* shard : m_shards)
+            {
+
+                if(shard->thread.joinable()) { shard->thread.join(); }
+
+            }
+        }
+
+        // ShardOf(index) returns the shard that owns the connection slot at index.
+        inline uint32_t shardOf(uint32_t index) const noexcept
+        {
+
+            return index % m_numShards;
+
+        }
+
+        // SetFlushRetryInterval(ms) sets how often a shard with backlogged connections retries them. It may be called at any time.
+        inline void setFlushRetryInterval(long ms) noexcept
+        {
+
+            m_flushRetryMs.store(ms < 1 ? 1 : ms, std::memory_order_relaxed);
+
+        }
+
+        // GetNumShards() returns the number of shards.
+        inline uint32_t getNumShards() const noexcept
+        {
+
+            return m_numShards;
+
+        }
+
+        // RequestFlush(shard) makes shard retry its backlogged connections until its flush function reports none remain.
+        // Only called while delivering for shard.
+        void requestFlush(uint32_t shard)
+        {
+
+            Shard& target = *m_shards[shard];
+
+            if(target.backlogged.exchange(true)) { return; }
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{target.mutex};
+
+            }
+
+            target.wakeup.notify_one();
+
+        }
+
+        // PostBroadcast(job) queues job on every shard.
+        void postBroadcast(const FanoutJob& job)
+        {
+
+            for(uint32_t shard = 0; shard < m_numShards; shard++) { enqueue(shard, job); }
+
+        }
+
+        // PostUnicast(job) queues job on the shard that owns job.target.
+        void postUnicast(const FanoutJob& job)
+        {
+
+            enqueue(shardOf(job.target.index), job);
+
+        }
+
+        // TryRunInline(job) delivers job on the calling thread, for every shard it concerns, if no shard has anything
+        // queued or in progress. It returns false (and does nothing) otherwise, in which case job should be posted.
+        bool tryRunInline(const FanoutJob& job)
+        {
+
+            if(!m_running || m_pendingJobs.load() != 0) { return false; }
+
+            boost::unique_lock<boost::shared_mutex> delivery{m_deliveryMutex, boost::try_to_lock};
+
+            if(!delivery.owns_lock() || m_pendingJobs.load() != 0) { return false; }
+
+            if(job.type == FANOUT_BROADCAST)
+            {
+
+                for(uint32_t shard = 0; shard < m_numShards; shard++) { m_deliver(shard, job); }
+
+            }
+            else
+            {
+
+                m_deliver(shardOf(job.target.index), job);
+
+            }
+
+            return true;
+
+        }
+};
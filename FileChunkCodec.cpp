@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// FileChunkCodec holds the parameters of the file transfer protocol shared by Client and Server, and the encoding of
+// file chunks. Chunks travel as base64 inside ordinary ';' terminated packets, so file data can never be mistaken for a
+// packet terminator, and the server relays them without looking inside.
+//
+// A transfer, with fields separated by spaces and the file name always last:
+//
+//     sender    -> server     %o%<recipient> <size> <name>;         Offer a file.
+//     server    -> sender     %o%<id> to <recipient> <size> <name>;  The offer, and its id (0 if it was refused).
+//     server    -> recipient  %o%<id> from <sender> <size> <name>;
+//     recipient -> sender     %a%<id>;                              Accept the file.
+//     sender    -> recipient  %d%<id> <sequence> <base64 chunk>;     Chunks, numbered from 0.
+//     recipient -> sender     %k%<id> <count>;                      The number of chunks received so far.
+//     either    -> other      %c%<id> <status>;                     Finish the transfer: done, declined, cancelled or failed.
+//
+// A sender may only send chunk n once at least n - WINDOW_SIZE + 1 chunks have been acknowledged.
+class FileChunkCodec
+{
+
+    public:
+
+        inline static const size_t CHUNK_SIZE = 16 * 1024; // The file bytes carried by each chunk but the last.
+        inline static const uint32_t WINDOW_SIZE = 4; // The most chunks of a transfer in flight, unacknowledged.
+
+        FileChunkCodec() = delete;
+
+        // Encode(data, length, out) appends the base64 encoding of length bytes of data to out.
+        static void encode(const char* data, size_t length, string& out)
+        {
+
+            static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+            size_t index = 0;
+            out.reserve(out.length() + (length + 2) / 3 * 4);
+
+            for(; index + 3 <= length; index += 3)
+            {
+
+                const uint32_t group = bytes[index] << 16 | bytes[index + 1] << 8 | bytes[index + 2];
+                out.push_back(alphabet[group >> 18]);
+                out.push_back(alphabet[(group >> 12) & 63]);
+                out.push_back(alphabet[(group >> 6) & 63]);
+                out.push_back(alphabet[group & 63]);
+
+            }
+
+            if(index < length)
+            {
+
+                const uint32_t group = bytes[index] << 16 | (index + 1 < length ? bytes[index + 1] << 8 : 0);
+                out.push_back(alphabet[group >> 18]);
+                out.push_back(alphabet[(group >> 12) & 63]);
+                out.push_back(index + 1 < length ? alphabet[(group >> 6) & 63] : '=');
+                out.push_back('=');
+
+            }
+        }
+
+        // Decode(text, length, out) replaces out with the bytes encoded in length characters of text. It returns false if
+        // text is not base64.
+        static bool decode(const char* text, size_t length, string& out)
+        {
+
+            out.clear();
+
+            if(length % 4 != 0) { return false; }
+
+            out.reserve(length / 4 * 3);
+
+            for(size_t index = 0; index < length; index += 4)
+            {
+
+                uint32_t group = 0;
+                int numPadding = 0;
+
+                for(size_t offset = 0; offset < 4; offset++)
+                {
+
+                    const char symbol = text[index + offset];
+                    int value;
+
+                    if(symbol >= 'A' && symbol <= 'Z') { value = symbol - 'A'; }
+                    else if(symbol >= 'a' && symbol <= 'z') { value = symbol - 'a' + 26; }
+                    else if(symbol >= '0' && symbol <= '9') { value = symbol - '0' + 52; }
+                    else if(symbol == '+') { value = 62; }
+                    else if(symbol == '/') { value = 63; }
+                    else if(symbol == '=' && index + 4 == length && offset >= 2) { value = 0; numPadding++; }
+                    else { return false; }
+
+                    // Padding may only be followed by padding.
+                    if(numPadding > 0 && symbol != '=') { return false; }
+
+                    group = group << 6 | value;
+
+                }
+
+                out.push_back(static_cast<char>(group >> 16));
+
+                if(numPadding < 2) { out.push_back(static_cast<char>((group >> 8) & 0xff)); }
+
+                if(numPadding < 1) { out.push_back(static_cast<char>(group & 0xff)); }
+
+            }
+
+            return true;
+
+        }
+};
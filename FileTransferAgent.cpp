@@ -0,0 +1,475 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/unordered_map.hpp>
+
+// USER DEFINED IMPORTS
+#include "PacketTagTypes.cpp"
+#include "FileChunkCodec.cpp"
+
+using std::string;
+
+// FileTransferAgent is the client end of file transfers (@see FileChunkCodec for the protocol). Outgoing files are read
+// and sent a chunk at a time as acknowledgements open the flow control window, so a transfer never holds more than
+// WINDOW_SIZE chunks in memory anywhere along the way. Incoming files are written to the working directory, under a
+// ".part" name until they are complete.
+class FileTransferAgent
+{
+
+    public:
+
+        typedef boost::function<void(const string& message, const string& tag)> SendFunction;
+        typedef boost::function<void(const string& line)> DisplayFunction;
+
+    private:
+
+        // OutgoingFile is a file this client offered or is sending.
+        struct OutgoingFile
+        {
+
+            FILE* file;
+            string recipient;
+            string name; // The name the recipient is offered the file under.
+            uint64_t size;
+            uint32_t numChunks;
+            uint32_t nextSequence; // The sequence of the next chunk to send.
+            uint32_t numAcked; // The number of chunks the recipient has acknowledged.
+            bool accepted;
+
+        };
+
+        // IncomingFile is a file offered to this client, or being received.
+        struct IncomingFile
+        {
+
+            FILE* file; // The ".part" file, once the offer has been accepted.
+            string sender;
+            string path; // Where the file is saved once complete.
+            uint64_t size;
+            uint64_t numReceived; // The bytes received so far.
+            uint32_t nextSequence; // The sequence of the next chunk expected.
+
+        };
+
+        SendFunction m_send; // Writes a packet to the server.
+        DisplayFunction m_display; // Shows a status line to the user.
+        std::vector<OutgoingFile> m_offered; // Offers sent to the server that have not been given an id yet.
+        boost::unordered_map<uint32_t, OutgoingFile> m_outgoing; // Outgoing files, by transfer id.
+        boost::unordered_map<uint32_t, IncomingFile> m_incoming; // Incoming files, by transfer id.
+        string m_chunk; // The file bytes of the chunk being sent or received.
+        boost::mutex m_mutex; // Guards every member. Held while sending, so the packets of each transfer stay in order.
+
+        // SafeName(name) returns name without any directories, and without characters the protocol cannot carry.
+        static string safeName(const string& name)
+        {
+
+            string safe = name.substr(name.find_last_of('/') == string::npos ? 0 : name.find_last_of('/') + 1);
+
+            for(char& symbol : safe)
+            {
+
+                if(symbol == ';' || symbol == '%') { symbol = '_'; }
+
+            }
+
+            return safe.empty() || safe == "." || safe == ".." ? string("file") : safe;
+
+        }
+
+        // UnusedPath(name) returns name, or name with a numeric suffix if a file of that name already exists.
+        static string unusedPath(const string& name)
+        {
+
+            struct stat status;
+            string path = name;
+
+            for(int suffix = 1; stat(path.c_str(), &status) == 0 || stat((path + ".part").c_str(), &status) == 0; suffix++)
+            {
+
+                path = name + "." + std::to_string(suffix);
+
+            }
+
+            return path;
+
+        }
+
+        // PumpLocked(id, outgoing) sends every chunk of outgoing that the flow control window allows, and finishes the
+        // transfer once every chunk is acknowledged. It returns false once the transfer is over. m_mutex must be held.
+        bool pumpLocked(uint32_t id, OutgoingFile& outgoing)
+        {
+
+            while(outgoing.nextSequence < outgoing.numChunks && outgoing.nextSequence < outgoing.numAcked + FileChunkCodec::WINDOW_SIZE)
+            {
+
+                m_chunk.resize(FileChunkCodec::CHUNK_SIZE);
+                const size_t numBytes = fread(&m_chunk[0], 1, FileChunkCodec::CHUNK_SIZE, outgoing.file);
+
+                if(numBytes == 0)
+                {
+
+                    m_send(std::to_string(id) + " failed;", PacketTagTypes::PKT_FILE_COMPLETE);
+                    m_display("[File]: Unable to read '" + outgoing.name + "'; the transfer has been cancelled.");
+                    return false;
+
+                }
+
+                string packet = std::to_string(id) + " " + std::to_string(outgoing.nextSequence++) + " ";
+                FileChunkCodec::encode(m_chunk.data(), numBytes, packet);
+                m_send(packet + ";", PacketTagTypes::PKT_FILE_DATA);
+
+            }
+
+            if(outgoing.numAcked < outgoing.numChunks) { return true; }
+
+            m_send(std::to_string(id) + " done;", PacketTagTypes::PKT_FILE_COMPLETE);
+            m_display("[File]: Sent '" + outgoing.name + "' to " + outgoing.recipient + ".");
+            return false;
+
+        }
+
+        // HandleOffer(content) handles the server's announcement of a transfer, to or from this client.
+        void handleOffer(const string& content)
+        {
+
+            char direction[8];
+            char peer[64];
+            unsigned long long size;
+            int nameStart = 0;
+            uint32_t id;
+
+            if(sscanf(content.c_str(), "%u %7s %63s %llu %n", &id, direction, peer, &size, &nameStart) < 4 || nameStart == 0) { return; }
+
+            const string name = content.substr(nameStart);
+
+            if(string(direction) == "to")
+            {
+
+                // Match the announcement to the offer it answers.
+                for(std::vector<OutgoingFile>::iterator offered = m_offered.begin(); offered != m_offered.end(); offered++)
+                {
+
+                    if(offered->recipient != peer || offered->name != name) { continue; }
+
+                    if(id == 0)
+                    {
+
+                        fclose(offered->file);
+
+                    }
+                    else
+                    {
+
+                        m_outgoing[id] = *offered;
+                        m_display("[File]: Offered '" + name + "' to " + peer + "; waiting for them to accept.");
+
+                    }
+
+                    m_offered.erase(offered);
+                    return;
+
+                }
+            }
+            else if(id != 0)
+            {
+
+                m_incoming[id] = IncomingFile{nullptr, peer, safeName(name), size, 0, 0};
+                m_display("[File]: " + string(peer) + " wants to send you '" + name + "' (" + std::to_string(size) + " bytes). Type /accept "
+                          + std::to_string(id) + " or /decline " + std::to_string(id) + ".");
+
+            }
+        }
+
+        // HandleChunk(content) writes a chunk of an incoming file, and acknowledges it.
+        void handleChunk(const string& content)
+        {
+
+            uint32_t id;
+            uint32_t sequence;
+            int dataStart = 0;
+
+            if(sscanf(content.c_str(), "%u %u %n", &id, &sequence, &dataStart) < 2 || dataStart == 0) { return; }
+
+            boost::unordered_map<uint32_t, IncomingFile>::iterator found = m_incoming.find(id);
+
+            if(found == m_incoming.end() || found->second.file == nullptr) { return; }
+
+            IncomingFile& incoming = found->second;
+
+            if(sequence != incoming.nextSequence || !FileChunkCodec::decode(content.data() + dataStart, content.length() - dataStart, m_chunk)
+               || incoming.numReceived + m_chunk.length() > incoming.size || fwrite(m_chunk.data(), 1, m_chunk.length(), incoming.file) != m_chunk.length())
+            {
+
+                m_send(std::to_string(id) + " failed;", PacketTagTypes::PKT_FILE_COMPLETE);
+                m_display("[File]: Receiving '" + incoming.path + "' failed.");
+                fclose(incoming.file);
+                ::remove((incoming.path + ".part").c_str());
+                m_incoming.erase(found);
+                return;
+
+            }
+
+            incoming.numReceived += m_chunk.length();
+            incoming.nextSequence++;
+            m_send(std::to_string(id) + " " + std::to_string(incoming.nextSequence) + ";", PacketTagTypes::PKT_FILE_ACK);
+
+        }
+
+        // HandleComplete(content) handles the end of a transfer, as reported by the other end or the server.
+        void handleComplete(const string& content)
+        {
+
+            char status[16];
+            uint32_t id;
+
+            if(sscanf(content.c_str(), "%u %15s", &id, status) < 2) { return; }
+
+            boost::unordered_map<uint32_t, OutgoingFile>::iterator outgoing = m_outgoing.find(id);
+
+            if(outgoing != m_outgoing.end())
+            {
+
+                m_display("[File]: Sending '" + outgoing->second.name + "' to " + outgoing->second.recipient + " " + status + ".");
+                fclose(outgoing->second.file);
+                m_outgoing.erase(outgoing);
+                return;
+
+            }
+
+            boost::unordered_map<uint32_t, IncomingFile>::iterator incoming = m_incoming.find(id);
+
+            if(incoming == m_incoming.end()) { return; }
+
+            IncomingFile& file = incoming->second;
+
+            if(file.file != nullptr)
+            {
+
+                fclose(file.file);
+
+                if(string(status) == "done" && file.numReceived == file.size && ::rename((file.path + ".part").c_str(), file.path.c_str()) == 0)
+                {
+
+                    m_display("[File]: Received '" + file.path + "' from " + file.sender + ".");
+
+                }
+                else
+                {
+
+                    ::remove((file.path + ".part").c_str());
+                    m_display("[File]: Receiving '" + file.path + "' from " + file.sender + " failed (" + status + ").");
+
+                }
+            }
+            else
+            {
+
+                m_display("[File]: " + file.sender + " withdrew their offer of '" + file.path + "'.");
+
+            }
+
+            m_incoming.erase(incoming);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        FileTransferAgent(const FileTransferAgent& rhs) = delete;
+        FileTransferAgent& operator=(const FileTransferAgent& rhs) = delete;
+
+        // Two-parameter constructor that writes packets to the server through send, and shows status lines through display.
+        FileTransferAgent(const SendFunction& send, const DisplayFunction& display) : m_send{send}, m_display{display} {}
+
+        // Destructor that closes every file still open. Incomplete incoming files are left behind as ".part" files.
+        ~FileTransferAgent()
+        {
+
+            for(OutgoingFile& offered : m_offered) { fclose(offered.file); }
+
+            for(boost::unordered_map<uint32_t, OutgoingFile>::value_type& outgoing : m_outgoing) { fclose(outgoing.second.file); }
+
+            for(boost::unordered_map<uint32_t, IncomingFile>::value_type& incoming : m_incoming)
+            {
+
+                if(incoming.second.file != nullptr) { fclose(incoming.second.file); }
+
+            }
+        }
+
+        // Offer(recipient, path) offers the file at path to recipient. It returns false if the file could not be opened.
+        bool offer(const string& recipient, const string& path)
+        {
+
+            FILE* file = fopen(path.c_str(), "rb");
+            struct stat status;
+
+            if(file == nullptr || fstat(fileno(file), &status) != 0 || !S_ISREG(status.st_mode))
+            {
+
+                if(file != nullptr) { fclose(file); }
+
+                return false;
+
+            }
+
+            const uint64_t size = status.st_size;
+            const string& name = safeName(path);
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            m_offered.push_back(OutgoingFile{file, recipient, name, size, static_cast<uint32_t>((size + FileChunkCodec::CHUNK_SIZE - 1) / FileChunkCodec::CHUNK_SIZE), 0, 0, false});
+            m_send(recipient + " " + std::to_string(size) + " " + name + ";", PacketTagTypes::PKT_FILE_OFFER);
+            return true;
+
+        }
+
+        // Accept(id) accepts the file offered as the transfer, id. It returns false if there is no such offer, or the file
+        // could not be created.
+        bool accept(uint32_t id)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, IncomingFile>::iterator found = m_incoming.find(id);
+
+            if(found == m_incoming.end() || found->second.file != nullptr) { return false; }
+
+            IncomingFile& incoming = found->second;
+            incoming.path = unusedPath(incoming.path);
+            incoming.file = fopen((incoming.path + ".part").c_str(), "wb");
+
+            if(incoming.file == nullptr) { return false; }
+
+            m_send(std::to_string(id) + ";", PacketTagTypes::PKT_FILE_ACCEPT);
+
+            if(incoming.size == 0)
+            {
+
+                // There are no chunks to wait for; the sender finishes at once.
+                m_display("[File]: Accepted '" + incoming.path + "'.");
+
+            }
+            else
+            {
+
+                m_display("[File]: Receiving '" + incoming.path + "' from " + incoming.sender + "...");
+
+            }
+
+            return true;
+
+        }
+
+        // Decline(id) cancels the transfer, id, whichever end of it this client is. It returns false if there is no such transfer.
+        bool decline(uint32_t id)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, IncomingFile>::iterator incoming = m_incoming.find(id);
+            boost::unordered_map<uint32_t, OutgoingFile>::iterator outgoing = m_outgoing.find(id);
+
+            if(incoming != m_incoming.end())
+            {
+
+                if(incoming->second.file != nullptr)
+                {
+
+                    fclose(incoming->second.file);
+                    ::remove((incoming->second.path + ".part").c_str());
+
+                }
+
+                m_send(std::to_string(id) + (incoming->second.file != nullptr ? " cancelled;" : " declined;"), PacketTagTypes::PKT_FILE_COMPLETE);
+                m_incoming.erase(incoming);
+                return true;
+
+            }
+
+            if(outgoing != m_outgoing.end())
+            {
+
+                fclose(outgoing->second.file);
+                m_send(std::to_string(id) + " cancelled;", PacketTagTypes::PKT_FILE_COMPLETE);
+                m_outgoing.erase(outgoing);
+                return true;
+
+            }
+
+            return false;
+
+        }
+
+        // HandlePacket(tag, content) handles a packet of the file transfer protocol. It returns false if tag is not one.
+        bool handlePacket(const string& tag, const string& content)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(tag == PacketTagTypes::PKT_FILE_DATA)
+            {
+
+                handleChunk(content);
+
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_ACK || tag == PacketTagTypes::PKT_FILE_ACCEPT)
+            {
+
+                uint32_t id;
+                uint32_t count = 0;
+
+                if(sscanf(content.c_str(), "%u %u", &id, &count) < 1) { return true; }
+
+                boost::unordered_map<uint32_t, OutgoingFile>::iterator found = m_outgoing.find(id);
+
+                if(found == m_outgoing.end()) { return true; }
+
+                if(tag == PacketTagTypes::PKT_FILE_ACCEPT)
+                {
+
+                    found->second.accepted = true;
+                    m_display("[File]: " + found->second.recipient + " accepted '" + found->second.name + "'; sending...");
+
+                }
+                else if(found->second.accepted && count > found->second.numAcked && count <= found->second.nextSequence)
+                {
+
+                    found->second.numAcked = count;
+
+                }
+
+                if(found->second.accepted && !pumpLocked(id, found->second))
+                {
+
+                    fclose(found->second.file);
+                    m_outgoing.erase(found);
+
+                }
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_OFFER)
+            {
+
+                handleOffer(content);
+
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_COMPLETE)
+            {
+
+                handleComplete(content);
+
+            }
+            else
+            {
+
+                return false;
+
+            }
+
+            return true;
+
+        }
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/unordered_map.hpp>
+
+// USER DEFINED IMPORTS
+#include "ConnectionSlab.cpp"
+#include "FileChunkCodec.cpp"
+
+// The outcome of FileTransferTable::relayChunk(..).
+enum ChunkRelayResult
+{
+
+    CHUNK_RELAY, // Forward the chunk to the recipient.
+    CHUNK_UNKNOWN, // Not a transfer the connection sends; ignore the chunk.
+    CHUNK_VIOLATION // Out of order or past the flow control window; the transfer has been closed.
+
+};
+
+// FileTransfer is a file transfer relayed between two connections.
+struct FileTransfer
+{
+
+    uint32_t id;
+    ConnectionHandle sender;
+    ConnectionHandle recipient;
+    bool accepted; // True once the recipient has accepted the file.
+    uint32_t nextSequence; // The sequence the next chunk must carry.
+    uint32_t numAcked; // The number of chunks the recipient has acknowledged.
+
+};
+
+// FileTransferTable tracks the file transfers a Server relays (@see FileChunkCodec for the protocol). It enforces the
+// flow control window of every transfer, so the chunks of a transfer queued for its recipient are bounded, and bounds the
+// transfers each connection may take part in.
+class FileTransferTable
+{
+
+    public:
+
+        inline static const uint32_t MAX_TRANSFERS_PER_CONNECTION = 4; // The most transfers a connection may send and receive at once.
+
+    private:
+
+        boost::unordered_map<uint32_t, FileTransfer> m_transfers; // Every open transfer, by id.
+        boost::unordered_map<uint64_t, uint32_t> m_numTransfersOf; // The number of open transfers of each connection, by keyOf(..).
+        uint32_t m_nextId; // The id of the next transfer opened. Never 0.
+        boost::mutex m_mutex; // Guards every member.
+
+        // KeyOf(handle) returns the key of handle in m_numTransfersOf.
+        static inline uint64_t keyOf(const ConnectionHandle& handle) noexcept
+        {
+
+            return static_cast<uint64_t>(handle.index) << 32 | handle.generation;
+
+        }
+
+        // CountOfLocked(handle) returns the number of open transfers of handle. m_mutex must be held.
+        uint32_t countOfLocked(const ConnectionHandle& handle) const
+        {
+
+            boost::unordered_map<uint64_t, uint32_t>::const_iterator found = m_numTransfersOf.find(keyOf(handle));
+            return found == m_numTransfersOf.end() ? 0 : found->second;
+
+        }
+
+        // CloseLocked(transfer) removes transfer. m_mutex must be held.
+        void closeLocked(const FileTransfer& transfer)
+        {
+
+            if(--m_numTransfersOf[keyOf(transfer.sender)] == 0) { m_numTransfersOf.erase(keyOf(transfer.sender)); }
+
+            if(--m_numTransfersOf[keyOf(transfer.recipient)] == 0) { m_numTransfersOf.erase(keyOf(transfer.recipient)); }
+
+            m_transfers.erase(transfer.id);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        FileTransferTable(const FileTransferTable& rhs) = delete;
+        FileTransferTable& operator=(const FileTransferTable& rhs) = delete;
+
+        // Default constructor.
+        FileTransferTable() noexcept : m_nextId{1} {}
+
+        // Open(sender, recipient) opens a transfer from sender to recipient, and returns its id. It returns 0 if either
+        // connection already takes part in MAX_TRANSFERS_PER_CONNECTION transfers.
+        uint32_t open(const ConnectionHandle& sender, const ConnectionHandle& recipient)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(sender == recipient || countOfLocked(sender) >= MAX_TRANSFERS_PER_CONNECTION || countOfLocked(recipient) >= MAX_TRANSFERS_PER_CONNECTION) { return 0; }
+
+            const uint32_t id = m_nextId++;
+
+            if(m_nextId == 0) { m_nextId = 1; }
+
+            m_transfers[id] = FileTransfer{id, sender, recipient, false, 0, 0};
+            m_numTransfersOf[keyOf(sender)]++;
+            m_numTransfersOf[keyOf(recipient)]++;
+            return id;
+
+        }
+
+        // Accept(id, from, sender) marks the transfer, id, as accepted and stores its sender in sender. It returns false
+        // unless from is the recipient of a transfer that has not been accepted yet.
+        bool accept(uint32_t id, const ConnectionHandle& from, ConnectionHandle& sender)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, FileTransfer>::iterator found = m_transfers.find(id);
+
+            if(found == m_transfers.end() || found->second.recipient != from || found->second.accepted) { return false; }
+
+            found->second.accepted = true;
+            sender = found->second.sender;
+            return true;
+
+        }
+
+        // RelayChunk(id, from, sequence, recipient) checks the chunk, sequence, that from sent on the transfer, id, and stores
+        // the recipient of the transfer in recipient. A chunk that breaks the protocol closes the transfer.
+        ChunkRelayResult relayChunk(uint32_t id, const ConnectionHandle& from, uint32_t sequence, ConnectionHandle& recipient)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, FileTransfer>::iterator found = m_transfers.find(id);
+
+            if(found == m_transfers.end() || found->second.sender != from) { return CHUNK_UNKNOWN; }
+
+            FileTransfer& transfer = found->second;
+            recipient = transfer.recipient;
+
+            if(!transfer.accepted || sequence != transfer.nextSequence || sequence >= transfer.numAcked + FileChunkCodec::WINDOW_SIZE)
+            {
+
+                closeLocked(transfer);
+                return CHUNK_VIOLATION;
+
+            }
+
+            transfer.nextSequence++;
+            return CHUNK_RELAY;
+
+        }
+
+        // Acknowledge(id, from, count, sender) records that the recipient, from, of the transfer, id, has received count
+        // chunks, and stores the sender of the transfer in sender. It returns false if count is not plausible.
+        bool acknowledge(uint32_t id, const ConnectionHandle& from, uint32_t count, ConnectionHandle& sender)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, FileTransfer>::iterator found = m_transfers.find(id);
+
+            if(found == m_transfers.end() || found->second.recipient != from) { return false; }
+
+            FileTransfer& transfer = found->second;
+
+            if(count < transfer.numAcked || count > transfer.nextSequence) { return false; }
+
+            transfer.numAcked = count;
+            sender = transfer.sender;
+            return true;
+
+        }
+
+        // Close(id, from, peer) closes the transfer, id, on behalf of from, and stores the other end of the transfer in
+        // peer. It returns false unless from takes part in the transfer.
+        bool close(uint32_t id, const ConnectionHandle& from, ConnectionHandle& peer)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, FileTransfer>::iterator found = m_transfers.find(id);
+
+            if(found == m_transfers.end() || (found->second.sender != from && found->second.recipient != from)) { return false; }
+
+            peer = found->second.sender == from ? found->second.recipient : found->second.sender;
+            closeLocked(found->second);
+            return true;
+
+        }
+
+        // CloseAll(handle, closed) closes every transfer that handle takes part in, and appends them to closed.
+        void closeAll(const ConnectionHandle& handle, std::vector<FileTransfer>& closed)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(countOfLocked(handle) == 0) { return; }
+
+            const size_t first = closed.size();
+
+            for(const boost::unordered_map<uint32_t, FileTransfer>::value_type& transfer : m_transfers)
+            {
+
+                if(transfer.second.sender == handle || transfer.second.recipient == handle) { closed.push_back(transfer.second); }
+
+            }
+
+            for(size_t index = first; index < closed.size(); index++) { closeLocked(closed[index]); }
+
+        }
+
+        // IsTransferring(handle) returns true if handle takes part in an open transfer.
+        bool isTransferring(const ConnectionHandle& handle)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            return countOfLocked(handle) > 0;
+
+        }
+};
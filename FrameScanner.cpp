@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_SCANNER_X86 1
+#endif
+
+// FrameScanner finds every frame delimiter in a receive buffer in a single pass, so a whole batch of frames can be parsed
+// from the resulting offsets. The scan is vectorized: SSE2 on every x86 CPU, and AVX2 where the CPU supports it, chosen
+// once at runtime. scanScalar(..) is the reference implementation the vectorized kernels must agree with.
+class FrameScanner
+{
+
+    public:
+
+        typedef void (*ScanFunction)(const char* data, uint32_t begin, uint32_t end, char delimiter, std::vector<uint32_t>& boundaries);
+
+    private:
+
+        // SelectKernel() returns the fastest kernel the running CPU supports.
+        static ScanFunction selectKernel() noexcept
+        {
+
+#ifdef FRAME_SCANNER_X86
+            __builtin_cpu_init();
+
+            if(__builtin_cpu_supports("avx2")) { return &FrameScanner::scanAvx2; }
+
+            return &FrameScanner::scanSse2;
+#else
+            return &FrameScanner::scanScalar;
+#endif
+
+        }
+
+    public:
+
+        FrameScanner() = delete;
+
+        // Scan(data, begin, end, delimiter, boundaries) appends to boundaries the index of every occurrence of delimiter in
+        // data[begin, end), in increasing order.
+        static inline void scan(const char* data, uint32_t begin, uint32_t end, char delimiter, std::vector<uint32_t>& boundaries)
+        {
+
+            static const ScanFunction kernel = selectKernel();
+            kernel(data, begin, end, delimiter, boundaries);
+
+        }
+
+        // GetKernelName() returns the name of the kernel scan(..) uses on this CPU.
+        static const char* getKernelName() noexcept
+        {
+
+            const ScanFunction kernel = selectKernel();
+
+#ifdef FRAME_SCANNER_X86
+            if(kernel == &FrameScanner::scanAvx2) { return "avx2"; }
+
+            if(kernel == &FrameScanner::scanSse2) { return "sse2"; }
+#endif
+
+            return "scalar";
+
+        }
+
+        // ScanScalar(data, begin, end, delimiter, boundaries) is the reference implementation of scan(..).
+        static void scanScalar(const char* data, uint32_t begin, uint32_t end, char delimiter, std::vector<uint32_t>& boundaries)
+        {
+
+            for(uint32_t index = begin; index < end; index++)
+            {
+
+                if(data[index] == delimiter) { boundaries.push_back(index); }
+
+            }
+        }
+
+#ifdef FRAME_SCANNER_X86
+        // ScanSse2(data, begin, end, delimiter, boundaries) is scan(..) comparing 16 bytes at a time.
+        __attribute__((target("sse2")))
+        static void scanSse2(const char* data, uint32_t begin, uint32_t end, char delimiter, std::vector<uint32_t>& boundaries)
+        {
+
+            const __m128i needle = _mm_set1_epi8(delimiter);
+            uint32_t index = begin;
+
+            for(; index + 16 <= end; index += 16)
+            {
+
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+
+                // Most blocks of a message body hold no delimiter at all.
+                while(mask != 0)
+                {
+
+                    boundaries.push_back(index + __builtin_ctz(mask));
+                    mask &= mask - 1;
+
+                }
+            }
+
+            scanScalar(data, index, end, delimiter, boundaries);
+
+        }
+
+        // ScanAvx2(data, begin, end, delimiter, boundaries) is scan(..) comparing 64 bytes, as two 32 byte halves, at a time.
+        __attribute__((target("avx2")))
+        static void scanAvx2(const char* data, uint32_t begin, uint32_t end, char delimiter, std::vector<uint32_t>& boundaries)
+        {
+
+            const __m256i needle = _mm256_set1_epi8(delimiter);
+            uint32_t index = begin;
+
+            for(; index + 64 <= end; index += 64)
+            {
+
+                const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+                const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index + 32));
+                uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle)))
+                              | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle)))) << 32;
+
+                while(mask != 0)
+                {
+
+                    boundaries.push_back(index + __builtin_ctzll(mask));
+                    mask &= mask - 1;
+
+                }
+            }
+
+            scanSse2(data, index, end, delimiter, boundaries);
+
+        }
+#endif
+};
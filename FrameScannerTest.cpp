@@ -0,0 +1,161 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "FrameScanner.cpp"
+#include <stdlib.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+// Kernel is a FrameScanner kernel under test, and whether the running CPU supports it.
+struct Kernel
+{
+
+    const char* name;
+    FrameScanner::ScanFunction scan;
+    bool supported;
+
+};
+
+// Kernels() returns every kernel FrameScanner may choose, the scalar reference first.
+std::vector<Kernel> kernels()
+{
+
+    std::vector<Kernel> result{{"scalar", &FrameScanner::scanScalar, true}};
+
+#ifdef FRAME_SCANNER_X86
+    __builtin_cpu_init();
+    result.push_back({"sse2", &FrameScanner::scanSse2, true});
+    result.push_back({"avx2", &FrameScanner::scanAvx2, __builtin_cpu_supports("avx2") != 0});
+#endif
+
+    return result;
+
+}
+
+// CheckEquivalence(numCases, seed) scans numCases random buffers with every supported kernel, at random offsets and
+// delimiter densities, and returns false at the first result that differs from the scalar reference.
+bool checkEquivalence(uint32_t numCases, uint32_t seed)
+{
+
+    std::mt19937 random{seed};
+    const std::vector<Kernel>& all = kernels();
+    std::vector<uint32_t> expected, actual;
+
+    for(uint32_t index = 0; index < numCases; index++)
+    {
+
+        // Lengths straddle the 16 and 64 byte blocks, and densities run from no delimiters to nothing but delimiters.
+        const uint32_t length = std::uniform_int_distribution<uint32_t>{0, index % 8 == 0 ? 65536u : 300u}(random);
+        const uint32_t density = std::uniform_int_distribution<uint32_t>{0, 100}(random);
+        const char delimiter = static_cast<char>(std::uniform_int_distribution<int>{0, 255}(random));
+        string data(length, '\0');
+
+        for(char& byte : data)
+        {
+
+            byte = std::uniform_int_distribution<uint32_t>{0, 99}(random) < density ? delimiter : static_cast<char>(std::uniform_int_distribution<int>{0, 255}(random));
+
+        }
+
+        const uint32_t begin = std::uniform_int_distribution<uint32_t>{0, length}(random);
+        const uint32_t end = std::uniform_int_distribution<uint32_t>{begin, length}(random);
+        expected.clear();
+        FrameScanner::scanScalar(data.data(), begin, end, delimiter, expected);
+
+        for(const Kernel& kernel : all)
+        {
+
+            if(!kernel.supported) { continue; }
+
+            actual.clear();
+            kernel.scan(data.data(), begin, end, delimiter, actual);
+
+            if(actual != expected)
+            {
+
+                cerr << kernel.name << " differs from scalar on case " << index << " (seed " << seed << ", length " << length << ", range [" << begin << ", " << end << "))" << endl;
+                return false;
+
+            }
+        }
+    }
+
+    return true;
+
+}
+
+// Benchmark(megabytes) prints the throughput of every supported kernel over a buffer of chat traffic of megabytes.
+void benchmark(uint32_t megabytes)
+{
+
+    // Messages of 20 to 200 bytes, each ending in a delimiter, like a burst of v1 packets.
+    std::mt19937 random{1};
+    string data;
+    data.reserve(static_cast<size_t>(megabytes) << 20);
+
+    while(data.size() < (static_cast<size_t>(megabytes) << 20))
+    {
+
+        data += "%m%";
+        data.append(std::uniform_int_distribution<size_t>{20, 200}(random), 'x');
+        data += ';';
+
+    }
+
+    std::vector<uint32_t> boundaries;
+    boundaries.reserve(data.size() / 20);
+
+    for(const Kernel& kernel : kernels())
+    {
+
+        if(!kernel.supported) { continue; }
+
+        const int numRounds = 10;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int round = 0; round < numRounds; round++)
+        {
+
+            boundaries.clear();
+            kernel.scan(data.data(), 0, static_cast<uint32_t>(data.size()), ';', boundaries);
+
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        cout << kernel.name << ": " << (static_cast<double>(data.size()) * numRounds / seconds / 1e9) << " GB/s (" << boundaries.size() << " frames per pass)" << endl;
+
+    }
+
+    cout << "scan(..) uses " << FrameScanner::getKernelName() << " on this CPU." << endl;
+
+}
+
+int main(int argc, char* argv[])
+{
+
+    if(argc > 4)
+    {
+
+        cerr << "Usage: [cases] [seed] [benchmark megabytes]" << endl;
+        return 1;
+
+    }
+
+    const uint32_t numCases = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 20000;
+    const uint32_t seed = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : std::random_device{}();
+    const uint32_t megabytes = argc > 3 ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 64;
+
+    if(!checkEquivalence(numCases, seed)) { return 1; }
+
+    cout << "Every kernel agreed with scalar on " << numCases << " random cases (seed " << seed << ")." << endl;
+
+    if(megabytes > 0) { benchmark(megabytes); }
+
+    return 0;
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/unordered_map.hpp>
+
+using std::string;
+
+// IgnoreMask is a bitset over connection slot indexes: bit i is set if the connection in slot i ignores some sender.
+class IgnoreMask
+{
+
+    public:
+
+        std::vector<uint64_t> words; // Bit i is bit (i % 64) of words[i / 64]; slots past the end are not set.
+
+        // Test(index) returns true if the bit of slot index is set.
+        inline bool test(uint32_t index) const noexcept
+        {
+
+            return (index >> 6) < words.size() && (words[index >> 6] >> (index & 63) & 1) != 0;
+
+        }
+};
+
+typedef boost::shared_ptr<const IgnoreMask> IgnoreMaskPtr;
+
+// The outcome of IgnoreTable::ignore(..).
+enum IgnoreResult
+{
+
+    IGNORE_ADDED, // The nickname is now ignored.
+    IGNORE_EXISTS, // The nickname was already ignored.
+    IGNORE_FULL // The connection already ignores MAX_IGNORED nicknames.
+
+};
+
+// IgnoreTable holds the nicknames each connection ignores, against the dense slot index of the connection. For every
+// ignored nickname it keeps a precomputed IgnoreMask of the connections that ignore it, so a broadcast from that nickname
+// skips them with a bit test per recipient, rather than a lookup. Masks are immutable once published and replaced as a
+// whole, so a broadcast can hold on to one without any locking. While nobody ignores anybody, isEmpty() is true and a
+// broadcast need not look for a mask at all.
+class IgnoreTable
+{
+
+    public:
+
+        inline static const size_t MAX_IGNORED = 64; // The most nicknames a connection may ignore.
+
+    private:
+
+        boost::unordered_map<uint32_t, std::vector<string>> m_listOf; // The nicknames each connection ignores, sorted, by slot index.
+        boost::unordered_map<string, IgnoreMaskPtr> m_maskOf; // The connections that ignore each nickname, by nickname.
+        std::atomic<size_t> m_numMasks; // The size of m_maskOf, readable without m_mutex.
+        boost::mutex m_mutex; // Guards m_listOf and m_maskOf.
+
+        // RebuildLocked(nickname) replaces the mask of nickname with one built from m_listOf. m_mutex must be held.
+        void rebuildLocked(const string& nickname)
+        {
+
+            boost::shared_ptr<IgnoreMask> mask = boost::make_shared<IgnoreMask>();
+
+            for(const boost::unordered_map<uint32_t, std::vector<string>>::value_type& list : m_listOf)
+            {
+
+                if(!std::binary_search(list.second.begin(), list.second.end(), nickname)) { continue; }
+
+                if(mask->words.size() <= (list.first >> 6)) { mask->words.resize((list.first >> 6) + 1, 0); }
+
+                mask->words[list.first >> 6] |= static_cast<uint64_t>(1) << (list.first & 63);
+
+            }
+
+            if(mask->words.empty()) { m_maskOf.erase(nickname); }
+            else { m_maskOf[nickname] = mask; }
+
+            m_numMasks = m_maskOf.size();
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        IgnoreTable(const IgnoreTable& rhs) = delete;
+        IgnoreTable& operator=(const IgnoreTable& rhs) = delete;
+
+        // Default constructor.
+        IgnoreTable() noexcept : m_numMasks{0} {}
+
+        // Ignore(index, nickname) makes the connection in slot index ignore nickname.
+        IgnoreResult ignore(uint32_t index, const string& nickname)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            std::vector<string>& list = m_listOf[index];
+            std::vector<string>::iterator position = std::lower_bound(list.begin(), list.end(), nickname);
+
+            if(position != list.end() && *position == nickname) { return IGNORE_EXISTS; }
+
+            if(list.size() >= MAX_IGNORED) { return IGNORE_FULL; }
+
+            list.insert(position, nickname);
+            rebuildLocked(nickname);
+            return IGNORE_ADDED;
+
+        }
+
+        // Unignore(index, nickname) stops the connection in slot index ignoring nickname. It returns false if it did not.
+        bool unignore(uint32_t index, const string& nickname)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, std::vector<string>>::iterator found = m_listOf.find(index);
+
+            if(found == m_listOf.end()) { return false; }
+
+            std::vector<string>::iterator position = std::lower_bound(found->second.begin(), found->second.end(), nickname);
+
+            if(position == found->second.end() || *position != nickname) { return false; }
+
+            found->second.erase(position);
+
+            if(found->second.empty()) { m_listOf.erase(found); }
+
+            rebuildLocked(nickname);
+            return true;
+
+        }
+
+        // Clear(index) forgets every nickname the connection in slot index ignores. It must be called before the slot is
+        // reused, so the next connection in it does not inherit the list.
+        void clear(uint32_t index)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, std::vector<string>>::iterator found = m_listOf.find(index);
+
+            if(found == m_listOf.end()) { return; }
+
+            std::vector<string> nicknames;
+            nicknames.swap(found->second);
+            m_listOf.erase(found);
+
+            for(const string& nickname : nicknames) { rebuildLocked(nickname); }
+
+        }
+
+        // IsIgnoring(index, nickname) returns true if the connection in slot index ignores nickname.
+        bool isIgnoring(uint32_t index, const string& nickname)
+        {
+
+            if(isEmpty()) { return false; }
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<uint32_t, std::vector<string>>::const_iterator found = m_listOf.find(index);
+            return found != m_listOf.end() && std::binary_search(found->second.begin(), found->second.end(), nickname);
+
+        }
+
+        // MutedBy(nickname) returns the mask of the connections that ignore nickname, or null if none do.
+        IgnoreMaskPtr mutedBy(const string& nickname)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<string, IgnoreMaskPtr>::const_iterator found = m_maskOf.find(nickname);
+            return found == m_maskOf.end() ? IgnoreMaskPtr{} : found->second;
+
+        }
+
+        // IsEmpty() returns true if nobody ignores anybody.
+        inline bool isEmpty() const noexcept
+        {
+
+            return m_numMasks.load(std::memory_order_relaxed) == 0;
+
+        }
+};
@@ -0,0 +1,464 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+using std::string;
+
+// The hops a traced message is timed across. Every stage is measured on the server's monotonic clock.
+enum LatencyStage : uint8_t
+{
+
+    STAGE_READ_WAIT, // From the kernel receiving the bytes to the reader thread reading them; this is where the read poll shows.
+    STAGE_PARSE, // From the read to the frame being parsed.
+    STAGE_ENQUEUE, // From the frame being parsed to its fanout being queued.
+    STAGE_WRITE, // From the fanout being queued to the frame being handed to a recipient's transport. Once per recipient.
+    STAGE_ACK, // From the fanout being queued to a recipient's Client reporting its arrival. Includes the return trip.
+    STAGE_NUM_STAGES
+
+};
+
+// LatencyHistogram is a log-linear histogram of nanosecond latencies: each power of two is split into SUB_BUCKETS
+// buckets, so every percentile it reports is within 1 / SUB_BUCKETS of the true value. Recording is lock-free.
+class LatencyHistogram
+{
+
+    private:
+
+        inline static const uint32_t SUB_BUCKET_BITS = 3;
+        inline static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS; // Buckets per power of two.
+        inline static const uint32_t NUM_BUCKETS = 64 * SUB_BUCKETS;
+
+        std::atomic<uint64_t> m_buckets[NUM_BUCKETS]; // The number of samples recorded in each bucket.
+        std::atomic<uint64_t> m_count; // The number of samples recorded.
+        std::atomic<uint64_t> m_sum; // The sum of every sample, for the mean.
+        std::atomic<uint64_t> m_max; // The largest sample.
+
+        // BucketOf(value) returns the bucket value is counted in.
+        static uint32_t bucketOf(uint64_t value) noexcept
+        {
+
+            if(value < SUB_BUCKETS) { return static_cast<uint32_t>(value); }
+
+            const uint32_t magnitude = 63 - __builtin_clzll(value);
+            const uint32_t subBucket = static_cast<uint32_t>(value >> (magnitude - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+            return (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+
+        }
+
+        // UpperBoundOf(bucket) returns the largest value counted in bucket.
+        static uint64_t upperBoundOf(uint32_t bucket) noexcept
+        {
+
+            if(bucket < SUB_BUCKETS) { return bucket; }
+
+            const uint32_t magnitude = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+            const uint64_t subBucket = bucket % SUB_BUCKETS;
+            return ((SUB_BUCKETS + subBucket + 1) << (magnitude - SUB_BUCKET_BITS)) - 1;
+
+        }
+
+    public:
+
+        // Default constructor.
+        LatencyHistogram() noexcept : m_buckets{}, m_count{0}, m_sum{0}, m_max{0} {}
+
+        // Record(nanoseconds) counts a single sample.
+        void record(int64_t nanoseconds) noexcept
+        {
+
+            const uint64_t value = nanoseconds < 0 ? 0 : static_cast<uint64_t>(nanoseconds);
+            m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(value, std::memory_order_relaxed);
+
+            uint64_t max = m_max.load(std::memory_order_relaxed);
+
+            while(value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+
+        }
+
+        // Reset() discards every sample.
+        void reset() noexcept
+        {
+
+            for(std::atomic<uint64_t>& bucket : m_buckets) { bucket.store(0, std::memory_order_relaxed); }
+
+            m_count = 0;
+            m_sum = 0;
+            m_max = 0;
+
+        }
+
+        // GetCount() returns the number of samples recorded.
+        inline uint64_t getCount() const noexcept
+        {
+
+            return m_count.load(std::memory_order_relaxed);
+
+        }
+
+        // GetMean() returns the mean of the samples, in nanoseconds.
+        inline uint64_t getMean() const noexcept
+        {
+
+            const uint64_t count = getCount();
+            return count == 0 ? 0 : m_sum.load(std::memory_order_relaxed) / count;
+
+        }
+
+        // GetMax() returns the largest sample, in nanoseconds.
+        inline uint64_t getMax() const noexcept
+        {
+
+            return m_max.load(std::memory_order_relaxed);
+
+        }
+
+        // GetPercentile(p) returns the p-th percentile of the samples, in nanoseconds.
+        uint64_t getPercentile(double p) const noexcept
+        {
+
+            const uint64_t count = getCount();
+
+            if(count == 0) { return 0; }
+
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count)));
+            uint64_t seen = 0;
+
+            for(uint32_t bucket = 0; bucket < NUM_BUCKETS; bucket++)
+            {
+
+                seen += m_buckets[bucket].load(std::memory_order_relaxed);
+
+                if(seen >= rank) { return std::min(upperBoundOf(bucket), getMax()); }
+
+            }
+
+            return getMax();
+
+        }
+};
+
+// LatencyTraceRecord holds the hop timestamps of a single traced message, in nanoseconds on the monotonic clock. A
+// timestamp of 0 means the hop has not happened (or, for arrived, that the transport cannot tell).
+struct LatencyTraceRecord
+{
+
+    uint32_t traceId; // 0 while this record is unused.
+    uint32_t connectionId; // The connection that sent the message.
+    int64_t arrived; // The kernel received the bytes of the message.
+    int64_t received; // The reader thread read them.
+    int64_t parsed; // The frame was parsed.
+    int64_t enqueued; // The fanout was queued.
+    int64_t firstWritten; // The first recipient's transport took the frame.
+    int64_t lastWritten; // The most recent recipient's transport took the frame.
+    int64_t lastAcked; // The most recent recipient reported the frame's arrival.
+    uint32_t numWritten; // The number of recipients whose transport took the frame.
+    uint32_t numAcked; // The number of recipients that reported the frame's arrival.
+
+};
+
+// LatencyTracer follows a sample of the messages relayed by a Server through every hop, from the kernel receiving them
+// to their recipients reporting their arrival. Every stage feeds a LatencyHistogram, and the most recent records can be
+// exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+//
+// While tracing is off, every hook costs a single atomic load.
+class LatencyTracer
+{
+
+    public:
+
+        inline static const size_t MAX_RECORDS = 4096; // The number of recent trace records kept for export.
+        inline static const size_t MAX_IN_FLIGHT = 64; // The number of traced frames whose queued writes are still matched to their trace.
+
+    private:
+
+        // InFlightFrame maps a traced frame that may be sitting in an OutboundQueue back to its trace.
+        struct InFlightFrame
+        {
+
+            boost::shared_ptr<const string> frame; // Held so the address is not reused while it is matched.
+            uint32_t traceId;
+
+        };
+
+        std::atomic<bool> m_active; // True while tracing.
+        std::atomic<uint32_t> m_sampleEvery; // One message out of this many is traced.
+        std::atomic<uint64_t> m_numMessages; // The number of messages offered to sample(..).
+        std::atomic<uint32_t> m_nextTraceId; // The id of the next traced message; never 0.
+        std::atomic<uint32_t> m_numInFlight; // The size of m_inFlight, readable without the lock.
+        int64_t m_start; // When tracing started; the origin of exported timestamps.
+        std::vector<LatencyTraceRecord> m_records; // The most recent records, indexed by traceId % MAX_RECORDS.
+        std::vector<InFlightFrame> m_inFlight; // The most recent traced frames, oldest first.
+        LatencyHistogram m_histograms[STAGE_NUM_STAGES]; // The latency of each stage.
+        boost::mutex m_mutex; // Guards m_records and m_inFlight.
+
+        // RecordOf(traceId) returns the record of traceId, or nullptr if it has been overwritten. m_mutex must be held.
+        LatencyTraceRecord* recordOf(uint32_t traceId)
+        {
+
+            LatencyTraceRecord& record = m_records[traceId % MAX_RECORDS];
+            return record.traceId == traceId && traceId != 0 ? &record : nullptr;
+
+        }
+
+        // WrittenLocked(record, timestamp) stamps a write of record at timestamp. m_mutex must be held.
+        void writtenLocked(LatencyTraceRecord& record, int64_t timestamp)
+        {
+
+            if(record.numWritten++ == 0) { record.firstWritten = timestamp; }
+
+            record.lastWritten = timestamp;
+            m_histograms[STAGE_WRITE].record(timestamp - record.enqueued);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        LatencyTracer(const LatencyTracer& rhs) = delete;
+        LatencyTracer& operator=(const LatencyTracer& rhs) = delete;
+
+        // Default constructor. Tracing is off until start(..) is called.
+        LatencyTracer() : m_active{false}, m_sampleEvery{1}, m_numMessages{0}, m_nextTraceId{1}, m_numInFlight{0}, m_start{0}, m_records(MAX_RECORDS) {}
+
+        // Now() returns the current time on the monotonic clock, in nanoseconds.
+        static inline int64_t now() noexcept
+        {
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        }
+
+        // Start(sampleEvery) starts tracing one message out of every sampleEvery, discarding any earlier traces.
+        void start(uint32_t sampleEvery)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            for(LatencyTraceRecord& record : m_records) { record = LatencyTraceRecord{}; }
+
+            for(LatencyHistogram& histogram : m_histograms) { histogram.reset(); }
+
+            m_inFlight.clear();
+            m_numInFlight = 0;
+            m_sampleEvery = sampleEvery == 0 ? 1 : sampleEvery;
+            m_start = now();
+            m_active.store(true, std::memory_order_release);
+
+        }
+
+        // Stop() stops tracing. The histograms and records are kept for reporting.
+        void stop()
+        {
+
+            m_active.store(false, std::memory_order_release);
+
+        }
+
+        // IsActive() returns true while tracing.
+        inline bool isActive() const noexcept
+        {
+
+            return m_active.load(std::memory_order_acquire);
+
+        }
+
+        // Sample(connectionId, arrived, received) decides whether the message just parsed from connectionId is traced. If
+        // it is, its record is started and its trace id returned; otherwise 0 is returned.
+        uint32_t sample(uint32_t connectionId, int64_t arrived, int64_t received)
+        {
+
+            if(!isActive() || m_numMessages.fetch_add(1, std::memory_order_relaxed) % m_sampleEvery != 0) { return 0; }
+
+            uint32_t traceId = m_nextTraceId.fetch_add(1, std::memory_order_relaxed);
+
+            if(traceId == 0) { traceId = m_nextTraceId.fetch_add(1, std::memory_order_relaxed); }
+
+            const int64_t parsed = now();
+
+            if(arrived != 0 && arrived <= received) { m_histograms[STAGE_READ_WAIT].record(received - arrived); }
+
+            m_histograms[STAGE_PARSE].record(parsed - received);
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            LatencyTraceRecord& record = m_records[traceId % MAX_RECORDS];
+            record = LatencyTraceRecord{};
+            record.traceId = traceId;
+            record.connectionId = connectionId;
+            record.arrived = arrived;
+            record.received = received;
+            record.parsed = parsed;
+            return traceId;
+
+        }
+
+        // Enqueued(traceId, frame) stamps the fanout of frame, the frame of traceId, as queued.
+        void enqueued(uint32_t traceId, const boost::shared_ptr<const string>& frame)
+        {
+
+            const int64_t timestamp = now();
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            LatencyTraceRecord* record = recordOf(traceId);
+
+            if(record == nullptr) { return; }
+
+            record->enqueued = timestamp;
+            m_histograms[STAGE_ENQUEUE].record(timestamp - record->parsed);
+
+            if(m_inFlight.size() == MAX_IN_FLIGHT) { m_inFlight.erase(m_inFlight.begin()); }
+
+            m_inFlight.push_back(InFlightFrame{frame, traceId});
+            m_numInFlight = m_inFlight.size();
+
+        }
+
+        // Written(traceId) stamps the frame of traceId as taken by one recipient's transport.
+        void written(uint32_t traceId)
+        {
+
+            const int64_t timestamp = now();
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            LatencyTraceRecord* record = recordOf(traceId);
+
+            if(record != nullptr) { writtenLocked(*record, timestamp); }
+
+        }
+
+        // FrameWritten(frame) stamps a write of frame, if it is a traced frame. This serves writes that were queued, where
+        // only the frame is at hand.
+        void frameWritten(const string* frame)
+        {
+
+            if(m_numInFlight.load(std::memory_order_relaxed) == 0) { return; }
+
+            const int64_t timestamp = now();
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            for(const InFlightFrame& inFlight : m_inFlight)
+            {
+
+                if(inFlight.frame.get() != frame) { continue; }
+
+                LatencyTraceRecord* record = recordOf(inFlight.traceId);
+
+                if(record != nullptr) { writtenLocked(*record, timestamp); }
+
+                return;
+
+            }
+        }
+
+        // Acked(traceId) stamps a recipient's report that the frame of traceId arrived.
+        void acked(uint32_t traceId)
+        {
+
+            if(!isActive()) { return; }
+
+            const int64_t timestamp = now();
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            LatencyTraceRecord* record = recordOf(traceId);
+
+            if(record == nullptr || record->enqueued == 0) { return; }
+
+            record->numAcked++;
+            record->lastAcked = timestamp;
+            m_histograms[STAGE_ACK].record(timestamp - record->enqueued);
+
+        }
+
+        // GetHistogram(stage) returns the latency histogram of stage.
+        inline const LatencyHistogram& getHistogram(LatencyStage stage) const noexcept
+        {
+
+            return m_histograms[stage];
+
+        }
+
+        // GetStageName(stage) returns a printable name for stage.
+        static const char* getStageName(LatencyStage stage) noexcept
+        {
+
+            static const char* const names[STAGE_NUM_STAGES] = {"read wait", "parse", "enqueue", "write", "ack"};
+            return names[stage];
+
+        }
+
+        // FormatSummary() returns one line per stage with its sample count and latency percentiles, in microseconds.
+        string formatSummary() const
+        {
+
+            string summary;
+            char line[256];
+
+            for(uint stage = 0; stage < STAGE_NUM_STAGES; stage++)
+            {
+
+                const LatencyHistogram& histogram = m_histograms[stage];
+                snprintf(line, sizeof(line), "%-9s n=%-8llu p50 %.1fus, p90 %.1fus, p99 %.1fus, p99.9 %.1fus, max %.1fus\n",
+                         getStageName(static_cast<LatencyStage>(stage)), static_cast<unsigned long long>(histogram.getCount()),
+                         histogram.getPercentile(50) / 1000.0, histogram.getPercentile(90) / 1000.0, histogram.getPercentile(99) / 1000.0,
+                         histogram.getPercentile(99.9) / 1000.0, histogram.getMax() / 1000.0);
+                summary += line;
+
+            }
+
+            return summary;
+
+        }
+
+        // ExportChromeTrace(path) writes the kept records to path in Chrome trace-event JSON. Each traced message is a track
+        // of its own, with one slice per stage. It returns false if the file could not be created.
+        bool exportChromeTrace(const string& path)
+        {
+
+            FILE* file = fopen(path.c_str(), "w");
+
+            if(file == nullptr) { return false; }
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            bool first = true;
+            fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+
+            for(const LatencyTraceRecord& record : m_records)
+            {
+
+                if(record.traceId == 0) { continue; }
+
+                // Each slice spans from one stamp to the next; hops that did not happen are left out.
+                const struct { const char* name; int64_t begin; int64_t end; } slices[] = {
+                    {"read wait", record.arrived, record.received},
+                    {"parse", record.received, record.parsed},
+                    {"enqueue", record.parsed, record.enqueued},
+                    {"write", record.enqueued, record.lastWritten},
+                    {"ack", record.enqueued, record.lastAcked}
+                };
+
+                for(const auto& slice : slices)
+                {
+
+                    if(slice.begin == 0 || slice.end == 0 || slice.end < slice.begin) { continue; }
+
+                    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                                  "\"args\":{\"connection\":%u,\"written\":%u,\"acked\":%u}}",
+                            first ? "" : ",", slice.name, record.traceId, (slice.begin - m_start) / 1000.0, (slice.end - slice.begin) / 1000.0,
+                            record.connectionId, record.numWritten, record.numAcked);
+                    first = false;
+
+                }
+            }
+
+            fputs("\n]}\n", file);
+            fclose(file);
+            return true;
+
+        }
+};
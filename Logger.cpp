@@ -0,0 +1,743 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <unistd.h>
+
+using std::string;
+
+// The severity of a log record. Records below the level set with Logger::setLevel(..) are discarded at the call site.
+enum LogLevel : uint8_t
+{
+
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_NUM_LEVELS
+
+};
+
+// What a thread should do when its log buffer is full.
+enum LogOverflowPolicy : uint8_t
+{
+
+    LOG_OVERFLOW_DROP, // Discard the record and count it (@see Logger::getDroppedCount()).
+    LOG_OVERFLOW_BLOCK // Wait for the writer thread to make room.
+
+};
+
+// LogThreadBuffer is a single-producer, single-consumer byte ring owned by one logging thread and drained by the writer thread.
+class LogThreadBuffer
+{
+
+    public:
+
+        inline static const uint32_t CAPACITY = 1 << 16; // The size of each per-thread ring in bytes. Always a power of two.
+
+    private:
+
+        alignas(64) std::atomic<uint64_t> m_head; // Total number of bytes committed by the owning thread.
+        alignas(64) std::atomic<uint64_t> m_tail; // Total number of bytes consumed by the writer thread.
+        alignas(64) uint64_t m_reserved; // The position the owning thread is currently encoding a record at.
+        std::atomic<bool> m_abandoned; // Set once the owning thread has exited.
+        char m_data[CAPACITY]; // The ring itself.
+
+    public:
+
+        // Default constructor.
+        LogThreadBuffer() noexcept : m_head{0}, m_tail{0}, m_reserved{0}, m_abandoned{false} {}
+
+        // TryReserve(size) returns true if size bytes are free, and positions the encoder at the start of them.
+        inline bool tryReserve(uint32_t size) noexcept
+        {
+
+            m_reserved = m_head.load(std::memory_order_relaxed);
+            return CAPACITY - (m_reserved - m_tail.load(std::memory_order_acquire)) >= size;
+
+        }
+
+        // Put(src, len) copies len bytes of src into the reserved region, wrapping if needed.
+        inline void put(const void* src, size_t len) noexcept
+        {
+
+            const size_t offset = m_reserved & (CAPACITY - 1);
+            const size_t first = std::min(len, CAPACITY - offset);
+            memcpy(m_data + offset, src, first);
+            memcpy(m_data, static_cast<const char*>(src) + first, len - first);
+            m_reserved += len;
+
+        }
+
+        // Commit() publishes everything put(..) since the last tryReserve(..) to the writer thread.
+        inline void commit() noexcept
+        {
+
+            m_head.store(m_reserved, std::memory_order_release);
+
+        }
+
+        // Drain(out) moves every committed byte into out and returns the number of bytes moved.
+        size_t drain(std::vector<char>& out)
+        {
+
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            const size_t len = head - tail;
+
+            if(len == 0) { return 0; }
+
+            const size_t offset = tail & (CAPACITY - 1);
+            const size_t first = std::min(len, CAPACITY - offset);
+            out.insert(out.end(), m_data + offset, m_data + offset + first);
+            out.insert(out.end(), m_data, m_data + (len - first));
+            m_tail.store(head, std::memory_order_release);
+            return len;
+
+        }
+
+        // Abandon() marks this buffer as no longer having an owning thread.
+        inline void abandon() noexcept
+        {
+
+            m_abandoned.store(true, std::memory_order_release);
+
+        }
+
+        // IsAbandoned() returns true if the owning thread has exited.
+        inline bool isAbandoned() const noexcept
+        {
+
+            return m_abandoned.load(std::memory_order_acquire);
+
+        }
+};
+
+// LogSharedBuffer is a multi-producer, single-consumer byte ring that many logging threads share, drained by the writer
+// thread. Producers claim space with a compare-and-swap and publish a record by storing its size, the first field of
+// its header, last; the writer thread zeroes whatever it consumes, so a record whose size is still zero is not published
+// yet. Records are padded to ALIGNMENT bytes, so that size field never wraps around the end of the ring.
+class LogSharedBuffer
+{
+
+    public:
+
+        inline static const uint32_t CAPACITY = 1 << 16; // The size of the ring in bytes. Always a power of two.
+        inline static const uint32_t ALIGNMENT = 8; // Every record starts on a multiple of this many bytes.
+
+        // Reservation is the space one producer has claimed in a LogSharedBuffer for a record.
+        class Reservation
+        {
+
+            private:
+
+                LogSharedBuffer& m_buffer; // The ring the space is in.
+                uint64_t m_start; // The position of the record.
+                uint64_t m_cursor; // The position the producer is currently encoding at.
+
+            public:
+
+                // Two-parameter constructor for the space at start in buffer.
+                Reservation(LogSharedBuffer& buffer, uint64_t start) noexcept : m_buffer{buffer}, m_start{start}, m_cursor{start} {}
+
+                // Put(src, len) copies len bytes of src into the reserved space, wrapping if needed.
+                inline void put(const void* src, size_t len) noexcept
+                {
+
+                    const size_t offset = m_cursor & (CAPACITY - 1);
+                    const size_t first = std::min(len, CAPACITY - offset);
+                    memcpy(m_buffer.m_data + offset, src, first);
+                    memcpy(m_buffer.m_data, static_cast<const char*>(src) + first, len - first);
+                    m_cursor += len;
+
+                }
+
+                // Commit(size) publishes the record, of size bytes, to the writer thread. Its header must have been put(..)
+                // with a size of zero.
+                inline void commit(uint32_t size) noexcept
+                {
+
+                    __atomic_store_n(m_buffer.sizeAt(m_start), size, __ATOMIC_RELEASE);
+
+                }
+        };
+
+    private:
+
+        alignas(64) std::atomic<uint64_t> m_reserved; // Total number of bytes claimed by producers.
+        alignas(64) std::atomic<uint64_t> m_tail; // Total number of bytes consumed by the writer thread.
+        alignas(64) char m_data[CAPACITY]; // The ring itself; zero wherever no record is published.
+
+        // SizeAt(position) returns the size field of the record at position.
+        inline uint32_t* sizeAt(uint64_t position) noexcept
+        {
+
+            return reinterpret_cast<uint32_t*>(m_data + (position & (CAPACITY - 1)));
+
+        }
+
+    public:
+
+        // Default constructor.
+        LogSharedBuffer() noexcept : m_reserved{0}, m_tail{0}, m_data{} {}
+
+        // PaddedSize(size) returns the space a record of size bytes takes in the ring.
+        static inline uint32_t paddedSize(uint32_t size) noexcept
+        {
+
+            return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+        }
+
+        // TryReserve(size, start) claims size bytes, a multiple of ALIGNMENT, and stores their position in start. It returns
+        // false if they are not free.
+        inline bool tryReserve(uint32_t size, uint64_t& start) noexcept
+        {
+
+            start = m_reserved.load(std::memory_order_relaxed);
+
+            do
+            {
+
+                if(CAPACITY - (start - m_tail.load(std::memory_order_acquire)) < size) { return false; }
+
+            }
+            while(!m_reserved.compare_exchange_weak(start, start + size, std::memory_order_relaxed));
+
+            return true;
+
+        }
+
+        // Drain(out) moves every published record up to the first that is not into out, and returns the number of bytes moved.
+        size_t drain(std::vector<char>& out)
+        {
+
+            const uint64_t start = m_tail.load(std::memory_order_relaxed);
+            uint64_t tail = start;
+            uint32_t size;
+
+            while((size = __atomic_load_n(sizeAt(tail), __ATOMIC_ACQUIRE)) != 0)
+            {
+
+                const size_t offset = tail & (CAPACITY - 1);
+                const size_t first = std::min<size_t>(size, CAPACITY - offset);
+                out.insert(out.end(), m_data + offset, m_data + offset + first);
+                out.insert(out.end(), m_data, m_data + (size - first));
+                memset(m_data + offset, 0, first);
+                memset(m_data, 0, size - first);
+                tail += size;
+
+            }
+
+            if(tail != start) { m_tail.store(tail, std::memory_order_release); }
+
+            return tail - start;
+
+        }
+};
+
+// Logger is an asynchronous logging subsystem. Each thread that logs gets its own lock-free ring; a background writer
+// thread drains every ring, formats the records and issues a single write(..) per batch. Call sites only copy their
+// arguments into the ring as structured binary, so formatting and the (possibly slow) stdout never sit on the relay path.
+// Threads that are too numerous to own a ring each, such as one per connection, share a single lock-free ring instead
+// (@see shareBuffer()).
+//
+// The format argument of log(..) must be a string literal: only its address is recorded, and every "{}" inside of it is
+// substituted with the next argument when the writer thread formats the record.
+class Logger
+{
+
+    private:
+
+        // The fixed-size header of every record inside of a LogThreadBuffer. It is followed by argc encoded arguments.
+        struct RecordHeader
+        {
+
+            uint32_t size; // The size of the whole record, including this header.
+            LogLevel level; // The severity of the record.
+            uint8_t argc; // The number of encoded arguments that follow.
+            int64_t timestamp; // Nanoseconds on the system clock when the record was logged.
+            const char* format; // The string literal describing how to format the record.
+
+        };
+
+        inline static const char ARG_STRING = 'S'; // Argument type tag: uint32 length followed by the bytes.
+        inline static const char ARG_SIGNED = 'I'; // Argument type tag: int64.
+        inline static const char ARG_UNSIGNED = 'U'; // Argument type tag: uint64.
+
+        std::atomic<uint8_t> m_level; // The minimum level that is recorded.
+        std::atomic<uint32_t> m_sampleEvery[LOG_NUM_LEVELS]; // For each level, one out of this many records is kept.
+        std::atomic<uint8_t> m_overflowPolicy; // @see LogOverflowPolicy.
+        std::atomic<uint64_t> m_dropped; // The number of records discarded because a ring was full.
+        std::atomic<int> m_fd; // The file descriptor that formatted records are written to.
+        std::atomic<bool> m_running; // The running status of the writer thread.
+        std::atomic<uint64_t> m_drainedBatches; // The number of writer passes completed; used by flush().
+        boost::mutex m_buffersMutex; // Guards m_buffers.
+        std::vector<boost::shared_ptr<LogThreadBuffer>> m_buffers; // Every registered per-thread ring.
+        boost::scoped_ptr<LogSharedBuffer> m_sharedBuffer; // The ring of every thread that called shareBuffer().
+        inline static thread_local bool t_sharesBuffer = false; // True if the calling thread logs through m_sharedBuffer.
+        inline static thread_local uint64_t t_sampleCounters[LOG_NUM_LEVELS] = {}; // Per-level record counters of the calling thread, used for sampling.
+        boost::thread m_writerThread; // The background writer thread.
+
+        // Default constructor that starts the writer thread; hidden to enforce singleton use (@see getInstance()).
+        Logger() : m_level{LOG_INFO}, m_sampleEvery{}, m_overflowPolicy{LOG_OVERFLOW_DROP}, m_dropped{0}, m_fd{STDOUT_FILENO}, m_running{true}, m_drainedBatches{0}, m_sharedBuffer{new LogSharedBuffer}
+        {
+
+            for(auto& every : m_sampleEvery) { every.store(1); }
+
+            m_writerThread = boost::thread{boost::bind(&Logger::runWriter, this)};
+
+        }
+
+        // ThreadBuffer() returns the ring of the calling thread, registering a new one on first use.
+        LogThreadBuffer& threadBuffer()
+        {
+
+            // The holder marks the ring as abandoned when its thread exits; the writer thread frees it once drained.
+            struct Holder
+            {
+
+                boost::shared_ptr<LogThreadBuffer> buffer;
+                ~Holder() { if(buffer.get() != nullptr) { buffer->abandon(); } }
+
+            };
+
+            static thread_local Holder holder;
+
+            if(holder.buffer.get() == nullptr)
+            {
+
+                holder.buffer.reset(new LogThreadBuffer);
+                boost::lock_guard<boost::mutex> lock{m_buffersMutex};
+                m_buffers.push_back(holder.buffer);
+
+            }
+
+            return *holder.buffer;
+
+        }
+
+        // Argument encoding.
+
+        static inline uint32_t encodedSize() noexcept { return 0; }
+
+        template <typename T, typename... Rest>
+        static inline uint32_t encodedSize(const T& arg, const Rest&... rest) noexcept
+        {
+
+            return argSize(arg) + encodedSize(rest...);
+
+        }
+
+        static inline uint32_t argSize(const string& arg) noexcept { return 1 + sizeof(uint32_t) + arg.size(); }
+        static inline uint32_t argSize(const char* arg) noexcept { return 1 + sizeof(uint32_t) + strlen(arg); }
+
+        template <typename T>
+        static inline uint32_t argSize(const T& /* arg */) noexcept
+        {
+
+            static_assert(std::is_integral<T>::value, "Logger only records strings and integers.");
+            return 1 + sizeof(uint64_t);
+
+        }
+
+        // The encoders write through a Sink: a LogThreadBuffer, or a LogSharedBuffer::Reservation.
+
+        template <typename Sink>
+        static inline void encode(Sink& /* sink */) noexcept {}
+
+        template <typename Sink, typename T, typename... Rest>
+        static inline void encode(Sink& buffer, const T& arg, const Rest&... rest) noexcept
+        {
+
+            encodeArg(buffer, arg);
+            encode(buffer, rest...);
+
+        }
+
+        template <typename Sink>
+        static inline void encodeString(Sink& buffer, const char* data, uint32_t len) noexcept
+        {
+
+            buffer.put(&ARG_STRING, 1);
+            buffer.put(&len, sizeof(len));
+            buffer.put(data, len);
+
+        }
+
+        template <typename Sink>
+        static inline void encodeArg(Sink& buffer, const string& arg) noexcept { encodeString(buffer, arg.data(), arg.size()); }
+
+        template <typename Sink>
+        static inline void encodeArg(Sink& buffer, const char* arg) noexcept { encodeString(buffer, arg, strlen(arg)); }
+
+        template <typename Sink, typename T>
+        static inline typename std::enable_if<std::is_integral<T>::value>::type encodeArg(Sink& buffer, const T& arg) noexcept
+        {
+
+            if(std::is_signed<T>::value)
+            {
+
+                const int64_t value = static_cast<int64_t>(arg);
+                buffer.put(&ARG_SIGNED, 1);
+                buffer.put(&value, sizeof(value));
+
+            }
+            else
+            {
+
+                const uint64_t value = static_cast<uint64_t>(arg);
+                buffer.put(&ARG_UNSIGNED, 1);
+                buffer.put(&value, sizeof(value));
+
+            }
+        }
+
+        // WaitForSpace(size, capacity) is called when a ring of capacity bytes has no room for a record of size. It returns
+        // true if the caller should try again, or counts the record as dropped and returns false.
+        bool waitForSpace(uint32_t size, uint32_t capacity)
+        {
+
+            if(m_overflowPolicy.load(std::memory_order_relaxed) == LOG_OVERFLOW_DROP || size > capacity)
+            {
+
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+
+            }
+
+            boost::this_thread::yield();
+            return true;
+
+        }
+
+        // Now() returns nanoseconds on the system clock.
+        static inline int64_t now() noexcept
+        {
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        }
+
+        // Record(buffer, level, format, args) encodes a record into the ring of the calling thread, buffer.
+        template <typename... Args>
+        void record(LogThreadBuffer& buffer, LogLevel level, const char* format, const Args&... args)
+        {
+
+            const uint32_t size = sizeof(RecordHeader) + encodedSize(args...);
+
+            while(!buffer.tryReserve(size))
+            {
+
+                if(!waitForSpace(size, LogThreadBuffer::CAPACITY)) { return; }
+
+            }
+
+            RecordHeader header{size, level, static_cast<uint8_t>(sizeof...(args)), now(), format};
+            buffer.put(&header, sizeof(header));
+            encode(buffer, args...);
+            buffer.commit();
+
+        }
+
+        // RecordShared(level, format, args) encodes a record into m_sharedBuffer, which other threads may be producing into
+        // at the same time.
+        template <typename... Args>
+        void recordShared(LogLevel level, const char* format, const Args&... args)
+        {
+
+            const uint32_t size = LogSharedBuffer::paddedSize(sizeof(RecordHeader) + encodedSize(args...));
+            uint64_t start;
+
+            while(!m_sharedBuffer->tryReserve(size, start))
+            {
+
+                if(!waitForSpace(size, LogSharedBuffer::CAPACITY)) { return; }
+
+            }
+
+            // The size is stored last, by commit(..), as storing it publishes the record.
+            LogSharedBuffer::Reservation reservation{*m_sharedBuffer, start};
+            RecordHeader header{0, level, static_cast<uint8_t>(sizeof...(args)), now(), format};
+            reservation.put(&header, sizeof(header));
+            encode(reservation, args...);
+            reservation.commit(size);
+
+        }
+
+        // Writer thread.
+
+        // FormatRecord(record, out) appends the text form of the encoded record to out.
+        static void formatRecord(const char* record, string& out)
+        {
+
+            RecordHeader header;
+            memcpy(&header, record, sizeof(header));
+            const char* arg = record + sizeof(header);
+            uint8_t argsLeft = header.argc;
+
+            for(const char* cursor = header.format; *cursor != '\0'; cursor++)
+            {
+
+                if(cursor[0] != '{' || cursor[1] != '}' || argsLeft == 0)
+                {
+
+                    out.push_back(*cursor);
+                    continue;
+
+                }
+
+                cursor++;
+                argsLeft--;
+
+                if(*arg == ARG_STRING)
+                {
+
+                    uint32_t len;
+                    memcpy(&len, arg + 1, sizeof(len));
+                    out.append(arg + 1 + sizeof(len), len);
+                    arg += 1 + sizeof(len) + len;
+
+                }
+                else
+                {
+
+                    uint64_t bits;
+                    memcpy(&bits, arg + 1, sizeof(bits));
+                    out.append(*arg == ARG_SIGNED ? std::to_string(static_cast<int64_t>(bits)) : std::to_string(bits));
+                    arg += 1 + sizeof(bits);
+
+                }
+            }
+
+            out.push_back('\n');
+
+        }
+
+        // FormatRecords(raw, text) appends the text form of every encoded record in raw to text.
+        static void formatRecords(const std::vector<char>& raw, string& text)
+        {
+
+            for(size_t offset = 0; offset < raw.size();)
+            {
+
+                uint32_t size;
+                memcpy(&size, raw.data() + offset, sizeof(size));
+                formatRecord(raw.data() + offset, text);
+                offset += size;
+
+            }
+        }
+
+        // DrainOnce() formats and writes every record currently committed to any ring. It returns the number of bytes drained.
+        size_t drainOnce(std::vector<char>& raw, string& text, uint64_t& reportedDrops)
+        {
+
+            std::vector<boost::shared_ptr<LogThreadBuffer>> buffers;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_buffersMutex};
+                buffers = m_buffers;
+
+            }
+
+            text.clear();
+            raw.clear();
+            size_t drained = m_sharedBuffer->drain(raw);
+            formatRecords(raw, text);
+
+            for(auto& buffer : buffers)
+            {
+
+                // Check for abandonment before draining, so nothing committed by an exiting thread is ever lost.
+                const bool abandoned = buffer->isAbandoned();
+                raw.clear();
+                drained += buffer->drain(raw);
+                formatRecords(raw, text);
+
+                if(abandoned)
+                {
+
+                    boost::lock_guard<boost::mutex> lock{m_buffersMutex};
+                    m_buffers.erase(std::remove(m_buffers.begin(), m_buffers.end(), buffer), m_buffers.end());
+
+                }
+            }
+
+            const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+
+            if(dropped != reportedDrops)
+            {
+
+                text += "[Logger]: " + std::to_string(dropped - reportedDrops) + " records dropped.\n";
+                reportedDrops = dropped;
+
+            }
+
+            for(size_t written = 0; written < text.size();)
+            {
+
+                ssize_t result = ::write(m_fd.load(std::memory_order_relaxed), text.data() + written, text.size() - written);
+
+                if(result <= 0) { break; }
+
+                written += result;
+
+            }
+
+            m_drainedBatches.fetch_add(1, std::memory_order_release);
+            return drained;
+
+        }
+
+        // RunWriter() is the body of the writer thread. It drains continuously while records arrive and backs off when idle.
+        void runWriter()
+        {
+
+            std::vector<char> raw;
+            string text;
+            uint64_t reportedDrops = 0;
+
+            while(m_running.load(std::memory_order_acquire))
+            {
+
+                if(drainOnce(raw, text, reportedDrops) == 0)
+                {
+
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+
+                }
+            }
+
+            drainOnce(raw, text, reportedDrops);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        Logger(const Logger& rhs) = delete;
+        Logger& operator=(const Logger& rhs) = delete;
+
+        // Destructor that stops the writer thread after a final drain.
+        ~Logger()
+        {
+
+            m_running.store(false, std::memory_order_release);
+
+            if(m_writerThread.joinable())
+            {
+
+                m_writerThread.join();
+
+            }
+        }
+
+        // GetInstance() is a singleton method that returns a static instance of this class. Only one
+        // instance should be created during the lifetime of the application.
+        static Logger& getInstance()
+        {
+
+            static Logger inst;
+            return inst;
+
+        }
+
+        // Log(level, format, args) records a message of level. The message is formatted later, on the writer thread.
+        template <typename... Args>
+        void log(LogLevel level, const char* format, const Args&... args)
+        {
+
+            if(level < m_level.load(std::memory_order_relaxed)) { return; }
+
+            const uint32_t every = m_sampleEvery[level].load(std::memory_order_relaxed);
+
+            if(every > 1 && t_sampleCounters[level]++ % every != 0) { return; }
+
+            if(t_sharesBuffer) { recordShared(level, format, args...); }
+            else { record(threadBuffer(), level, format, args...); }
+
+        }
+
+        // ShareBuffer() makes the calling thread log through a lock-free ring shared with every other thread that called it,
+        // rather than one of its own, so it costs no memory of its own. Call it before the thread first logs.
+        inline void shareBuffer() noexcept
+        {
+
+            t_sharesBuffer = true;
+
+        }
+
+        // GetSharedBufferBytes() returns the memory held by the ring of the threads that called shareBuffer().
+        inline size_t getSharedBufferBytes() const noexcept
+        {
+
+            return sizeof(LogSharedBuffer);
+
+        }
+
+        // Flush() blocks until every record logged before this call has been written.
+        void flush()
+        {
+
+            // Two completed passes guarantee at least one pass started after this call.
+            const uint64_t target = m_drainedBatches.load(std::memory_order_acquire) + 2;
+
+            while(m_running.load(std::memory_order_acquire) && m_drainedBatches.load(std::memory_order_acquire) < target)
+            {
+
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
+            }
+        }
+
+        // SetLevel(level) discards every future record below level.
+        inline void setLevel(LogLevel level) noexcept
+        {
+
+            m_level.store(level, std::memory_order_relaxed);
+
+        }
+
+        // SetSampling(level, every) keeps one out of every records of level, per thread. An every of 1 keeps them all.
+        inline void setSampling(LogLevel level, uint32_t every) noexcept
+        {
+
+            m_sampleEvery[level].store(every == 0 ? 1 : every, std::memory_order_relaxed);
+
+        }
+
+        // SetOverflowPolicy(policy) selects what happens when a thread's ring is full.
+        inline void setOverflowPolicy(LogOverflowPolicy policy) noexcept
+        {
+
+            m_overflowPolicy.store(policy, std::memory_order_relaxed);
+
+        }
+
+        // SetOutput(fd) redirects formatted records to the file descriptor, fd.
+        inline void setOutput(int fd) noexcept
+        {
+
+            m_fd.store(fd, std::memory_order_relaxed);
+
+        }
+
+        // GetDroppedCount() returns the number of records discarded because a ring was full.
+        inline uint64_t getDroppedCount() const noexcept
+        {
+
+            return m_dropped.load(std::memory_order_relaxed);
+
+        }
+};
@@ -0,0 +1,536 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+using std::string;
+
+// A mailbox segment file begins with a MailboxSegmentHeader, followed by back-to-back records. Each record is a
+// MailboxRecordHeader, the recipient nickname and the frame to deliver, padded to MAILBOX_RECORD_ALIGN bytes. Segments
+// are created at full size and zero filled, so a record with a recordSize of 0 marks the end of the records.
+struct MailboxSegmentHeader
+{
+
+    char magic[4]; // Always "TCMB".
+    uint32_t version; // The version of this file layout; currently 1.
+    uint64_t reserved; // Always 0.
+
+};
+
+struct MailboxRecordHeader
+{
+
+    uint32_t recordSize; // The size of the whole record, padding included. Stored last, so a torn append is never read back.
+    uint32_t payloadSize; // The size of the frame to deliver.
+    uint64_t sequence; // Orders the records of a mailbox, which compaction may move to a later segment.
+    uint8_t recipientSize; // The size of the recipient nickname.
+    uint8_t state; // MAILBOX_RECORD_QUEUED or MAILBOX_RECORD_DELIVERED.
+    uint8_t reserved[6]; // Always 0.
+
+};
+
+static const uint32_t MAILBOX_VERSION = 1;
+static const uint32_t MAILBOX_RECORD_ALIGN = 8;
+static const uint8_t MAILBOX_RECORD_QUEUED = 0; // The record waits for its recipient to join.
+static const uint8_t MAILBOX_RECORD_DELIVERED = 1; // The record was handed to its recipient, and only awaits compaction.
+
+// OfflineMailbox keeps the private messages sent to users that are not online, until they join. Messages are appended to
+// memory-mapped segment files in a directory, so they survive a restart of the server; an in-memory index from each
+// nickname to the location of its messages is rebuilt from the segments when the mailbox is opened.
+//
+// Taking a mailbox copies its messages straight out of the mapped segments into one buffer, so a user with thousands of
+// queued messages receives them in a single write. Delivered records are only flagged in place; a segment is compacted,
+// by moving its remaining records to the end of the newest segment, once most of it has been delivered.
+class OfflineMailbox
+{
+
+    public:
+
+        inline static const uint32_t SEGMENT_SIZE = 8 << 20; // The size of each segment file.
+        inline static const size_t MAX_SEGMENTS = 64; // Bounds the disk space of the mailbox to MAX_SEGMENTS * SEGMENT_SIZE.
+        inline static const size_t MAX_MESSAGES_PER_RECIPIENT = 4096; // The most messages queued for a single nickname.
+        inline static const size_t MAX_BYTES_PER_RECIPIENT = 512 * 1024; // The most bytes queued for a single nickname.
+        inline static const uint32_t COMPACT_LIVE_RATIO = 4; // A full segment is compacted once under 1 / COMPACT_LIVE_RATIO of it is still queued.
+
+    private:
+
+        // MailboxEntry is the location of a queued record.
+        struct MailboxEntry
+        {
+
+            uint64_t sequence;
+            uint32_t segment; // The number of the segment holding the record.
+            uint32_t offset; // The offset of the record within its segment.
+            uint32_t recordSize;
+            uint32_t payloadSize;
+
+        };
+
+        // Mailbox is the queue of a single nickname, in sequence order.
+        struct Mailbox
+        {
+
+            std::vector<MailboxEntry> entries;
+            size_t numBytes; // The sum of the payload sizes of entries.
+
+        };
+
+        // MailboxSegment is a mapped segment file.
+        struct MailboxSegment
+        {
+
+            char* data; // The mapping of the whole segment file.
+            uint32_t writeOffset; // The offset at which the next record is appended.
+            uint32_t liveBytes; // The bytes of the records still queued.
+
+        };
+
+        string m_directory; // The directory holding the segment files. Empty while closed.
+        std::map<uint32_t, MailboxSegment> m_segments; // Every segment, by number. The highest numbered is the one appended to.
+        boost::unordered_map<string, Mailbox> m_mailboxes; // The queue of every nickname with messages waiting.
+        uint64_t m_nextSequence; // The sequence of the next record stored.
+        size_t m_numQueued; // The number of messages queued across every mailbox.
+        boost::mutex m_mutex; // Guards every member.
+
+        // SegmentPath(number) returns the path of the segment file, number.
+        string segmentPath(uint32_t number) const
+        {
+
+            char name[32];
+            snprintf(name, sizeof(name), "/%08u.mbx", number);
+            return m_directory + name;
+
+        }
+
+        // MapSegmentLocked(number, create) maps the segment file, number, creating it first if create is set. It returns
+        // nullptr if the file could not be created, or is not a segment file. m_mutex must be held.
+        MailboxSegment* mapSegmentLocked(uint32_t number, bool create)
+        {
+
+            const string& path = segmentPath(number);
+            const int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+
+            if(fd < 0) { return nullptr; }
+
+            struct stat status;
+
+            if((create && ftruncate(fd, SEGMENT_SIZE) != 0) || fstat(fd, &status) != 0 || status.st_size != SEGMENT_SIZE)
+            {
+
+                ::close(fd);
+                return nullptr;
+
+            }
+
+            void* data = mmap(nullptr, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+
+            if(data == MAP_FAILED) { return nullptr; }
+
+            MailboxSegmentHeader* header = static_cast<MailboxSegmentHeader*>(data);
+
+            if(create)
+            {
+
+                memcpy(header->magic, "TCMB", 4);
+                header->version = MAILBOX_VERSION;
+
+            }
+            else if(memcmp(header->magic, "TCMB", 4) != 0 || header->version != MAILBOX_VERSION)
+            {
+
+                munmap(data, SEGMENT_SIZE);
+                return nullptr;
+
+            }
+
+            MailboxSegment& segment = m_segments[number];
+            segment.data = static_cast<char*>(data);
+            segment.writeOffset = sizeof(MailboxSegmentHeader);
+            segment.liveBytes = 0;
+            return &segment;
+
+        }
+
+        // RemoveSegmentLocked(number) unmaps and deletes the segment file, number. m_mutex must be held.
+        void removeSegmentLocked(uint32_t number)
+        {
+
+            munmap(m_segments[number].data, SEGMENT_SIZE);
+            m_segments.erase(number);
+            ::unlink(segmentPath(number).c_str());
+
+        }
+
+        // LoadSegmentLocked(number, segment) adds the queued records of segment to the index. m_mutex must be held.
+        void loadSegmentLocked(uint32_t number, MailboxSegment& segment)
+        {
+
+            uint32_t offset = sizeof(MailboxSegmentHeader);
+
+            while(offset + sizeof(MailboxRecordHeader) <= SEGMENT_SIZE)
+            {
+
+                const MailboxRecordHeader* header = reinterpret_cast<const MailboxRecordHeader*>(segment.data + offset);
+
+                // Stop at the end of the records, or at anything that is not a whole record.
+                if(header->recordSize < sizeof(MailboxRecordHeader) + header->recipientSize + header->payloadSize
+                   || header->recordSize > SEGMENT_SIZE - offset) { break; }
+
+                if(header->state == MAILBOX_RECORD_QUEUED)
+                {
+
+                    Mailbox& mailbox = m_mailboxes[string(segment.data + offset + sizeof(MailboxRecordHeader), header->recipientSize)];
+                    mailbox.entries.push_back(MailboxEntry{header->sequence, number, offset, header->recordSize, header->payloadSize});
+                    mailbox.numBytes += header->payloadSize;
+                    segment.liveBytes += header->recordSize;
+                    m_numQueued++;
+
+                }
+
+                m_nextSequence = std::max(m_nextSequence, header->sequence + 1);
+                offset += header->recordSize;
+
+            }
+
+            segment.writeOffset = offset;
+
+        }
+
+        // AppendLocked(recipient, payload, payloadSize, sequence, entry) appends a record to the newest segment, starting a
+        // new segment if it is full, and stores its location in entry. It returns false if the mailbox has no room left.
+        // m_mutex must be held.
+        bool appendLocked(const string& recipient, const char* payload, uint32_t payloadSize, uint64_t sequence, MailboxEntry& entry)
+        {
+
+            const uint32_t recordSize = (sizeof(MailboxRecordHeader) + recipient.length() + payloadSize + MAILBOX_RECORD_ALIGN - 1) & ~(MAILBOX_RECORD_ALIGN - 1);
+            uint32_t number = m_segments.empty() ? 0 : m_segments.rbegin()->first;
+            MailboxSegment* segment = m_segments.empty() ? nullptr : &m_segments.rbegin()->second;
+
+            if(recordSize > SEGMENT_SIZE - sizeof(MailboxSegmentHeader)) { return false; }
+
+            if(segment == nullptr || recordSize > SEGMENT_SIZE - segment->writeOffset)
+            {
+
+                if(m_segments.size() >= MAX_SEGMENTS || (segment = mapSegmentLocked(++number, true)) == nullptr) { return false; }
+
+            }
+
+            char* record = segment->data + segment->writeOffset;
+            MailboxRecordHeader* header = reinterpret_cast<MailboxRecordHeader*>(record);
+            memcpy(record + sizeof(MailboxRecordHeader), recipient.data(), recipient.length());
+            memcpy(record + sizeof(MailboxRecordHeader) + recipient.length(), payload, payloadSize);
+            header->payloadSize = payloadSize;
+            header->sequence = sequence;
+            header->recipientSize = static_cast<uint8_t>(recipient.length());
+            header->state = MAILBOX_RECORD_QUEUED;
+            __atomic_store_n(&header->recordSize, recordSize, __ATOMIC_RELEASE);
+
+            entry = MailboxEntry{sequence, number, segment->writeOffset, recordSize, payloadSize};
+            segment->writeOffset += recordSize;
+            segment->liveBytes += recordSize;
+            return true;
+
+        }
+
+        // CloseLocked() unmaps every segment and empties the index. m_mutex must be held.
+        void closeLocked()
+        {
+
+            for(std::pair<const uint32_t, MailboxSegment>& segment : m_segments)
+            {
+
+                munmap(segment.second.data, SEGMENT_SIZE);
+
+            }
+
+            m_segments.clear();
+            m_mailboxes.clear();
+            m_directory.clear();
+            m_nextSequence = 1;
+            m_numQueued = 0;
+
+        }
+
+        // DropDuplicatesLocked(mailbox) removes the second copy of any record of mailbox, whose entries must be sorted. A
+        // crash while compacting can leave a record both in its old segment and at its new location. m_mutex must be held.
+        void dropDuplicatesLocked(Mailbox& mailbox)
+        {
+
+            std::vector<MailboxEntry>& entries = mailbox.entries;
+            size_t kept = 0;
+
+            for(size_t index = 0; index < entries.size(); index++)
+            {
+
+                if(kept > 0 && entries[kept - 1].sequence == entries[index].sequence)
+                {
+
+                    MailboxSegment& segment = m_segments[entries[index].segment];
+                    reinterpret_cast<MailboxRecordHeader*>(segment.data + entries[index].offset)->state = MAILBOX_RECORD_DELIVERED;
+                    segment.liveBytes -= entries[index].recordSize;
+                    mailbox.numBytes -= entries[index].payloadSize;
+                    m_numQueued--;
+                    continue;
+
+                }
+
+                entries[kept++] = entries[index];
+
+            }
+
+            entries.resize(kept);
+
+        }
+
+        // CompactLocked(number) moves the queued records of the segment, number, to the newest segment and deletes it, if
+        // the segment is full and mostly delivered. m_mutex must be held.
+        void compactLocked(uint32_t number)
+        {
+
+            std::map<uint32_t, MailboxSegment>::iterator found = m_segments.find(number);
+
+            if(found == m_segments.end() || number == m_segments.rbegin()->first) { return; }
+
+            const uint64_t liveBytes = found->second.liveBytes;
+
+            if(liveBytes > 0 && liveBytes * COMPACT_LIVE_RATIO >= found->second.writeOffset - sizeof(MailboxSegmentHeader)) { return; }
+
+            const char* data = found->second.data;
+            uint32_t offset = sizeof(MailboxSegmentHeader);
+
+            while(offset < found->second.writeOffset)
+            {
+
+                const MailboxRecordHeader* header = reinterpret_cast<const MailboxRecordHeader*>(data + offset);
+
+                if(header->state == MAILBOX_RECORD_QUEUED)
+                {
+
+                    const string recipient{data + offset + sizeof(MailboxRecordHeader), header->recipientSize};
+                    std::vector<MailboxEntry>& entries = m_mailboxes[recipient].entries;
+                    std::vector<MailboxEntry>::iterator entry = std::lower_bound(entries.begin(), entries.end(), header->sequence,
+                                                                                 [](const MailboxEntry& lhs, uint64_t sequence) { return lhs.sequence < sequence; });
+
+                    // Without room for the move, the segment is kept as it is.
+                    if(entry != entries.end() && entry->sequence == header->sequence && !appendLocked(recipient, data + offset + sizeof(MailboxRecordHeader) + header->recipientSize, header->payloadSize, header->sequence, *entry)) { return; }
+
+                    // Flag the original as moved, so a crash before the segment is deleted leaves one copy queued.
+                    const_cast<MailboxRecordHeader*>(header)->state = MAILBOX_RECORD_DELIVERED;
+
+                }
+
+                offset += header->recordSize;
+
+            }
+
+            removeSegmentLocked(number);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        OfflineMailbox(const OfflineMailbox& rhs) = delete;
+        OfflineMailbox& operator=(const OfflineMailbox& rhs) = delete;
+
+        // Default constructor. The mailbox stores nothing until open(..) is called.
+        OfflineMailbox() noexcept : m_nextSequence{1}, m_numQueued{0} {}
+
+        // Destructor that closes the mailbox.
+        ~OfflineMailbox()
+        {
+
+            close();
+
+        }
+
+        // Open(directory) opens the mailbox kept in directory, creating the directory if needed, and indexes the messages
+        // already queued there. It returns false if the directory or a segment in it could not be opened.
+        bool open(const string& directory)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            closeLocked();
+
+            if(mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) { return false; }
+
+            DIR* dir = opendir(directory.c_str());
+
+            if(dir == nullptr) { return false; }
+
+            std::vector<uint32_t> numbers;
+
+            for(struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+            {
+
+                uint32_t number;
+                char suffix[8];
+
+                if(sscanf(entry->d_name, "%8u.%7s", &number, suffix) == 2 && strcmp(suffix, "mbx") == 0) { numbers.push_back(number); }
+
+            }
+
+            closedir(dir);
+            m_directory = directory;
+
+            for(uint32_t number : numbers)
+            {
+
+                MailboxSegment* segment = mapSegmentLocked(number, false);
+
+                if(segment == nullptr)
+                {
+
+                    closeLocked();
+                    return false;
+
+                }
+
+                loadSegmentLocked(number, *segment);
+
+            }
+
+            for(boost::unordered_map<string, Mailbox>::value_type& mailbox : m_mailboxes)
+            {
+
+                std::sort(mailbox.second.entries.begin(), mailbox.second.entries.end(),
+                          [](const MailboxEntry& lhs, const MailboxEntry& rhs) { return lhs.sequence < rhs.sequence; });
+                dropDuplicatesLocked(mailbox.second);
+
+            }
+
+            // Catch up on compaction that was due when the mailbox was last closed.
+            for(uint32_t number : numbers) { compactLocked(number); }
+
+            return true;
+
+        }
+
+        // Close() unmaps every segment. The messages stay queued on disk.
+        void close()
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            closeLocked();
+
+        }
+
+        // IsOpen() returns true between open(..) and close().
+        bool isOpen()
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            return !m_directory.empty();
+
+        }
+
+        // Store(recipient, frame) queues frame until recipient takes its mailbox. It returns false if the mailbox is closed,
+        // the mailbox of recipient is at its quota, or the segments are out of room.
+        bool store(const string& recipient, const string& frame)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(m_directory.empty() || recipient.empty() || recipient.length() > UINT8_MAX || frame.length() > MAX_BYTES_PER_RECIPIENT) { return false; }
+
+            boost::unordered_map<string, Mailbox>::iterator found = m_mailboxes.find(recipient);
+
+            if(found != m_mailboxes.end() && (found->second.entries.size() >= MAX_MESSAGES_PER_RECIPIENT
+                                              || found->second.numBytes + frame.length() > MAX_BYTES_PER_RECIPIENT)) { return false; }
+
+            const uint32_t previousSegment = m_segments.empty() ? 0 : m_segments.rbegin()->first;
+            MailboxEntry entry;
+
+            if(!appendLocked(recipient, frame.data(), frame.length(), m_nextSequence, entry)) { return false; }
+
+            Mailbox& mailbox = found != m_mailboxes.end() ? found->second : m_mailboxes[recipient];
+            mailbox.entries.push_back(entry);
+            mailbox.numBytes += frame.length();
+            m_nextSequence++;
+            m_numQueued++;
+
+            // The previous segment is now full, and may already be mostly delivered.
+            if(entry.segment != previousSegment) { compactLocked(previousSegment); }
+
+            return true;
+
+        }
+
+        // Take(recipient, frames) appends every frame queued for recipient to frames, in the order they were stored, and
+        // empties its mailbox. It returns the number of frames taken.
+        size_t take(const string& recipient, string& frames)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            boost::unordered_map<string, Mailbox>::iterator found = m_mailboxes.find(recipient);
+
+            if(found == m_mailboxes.end()) { return 0; }
+
+            const std::vector<MailboxEntry>& entries = found->second.entries;
+            std::vector<uint32_t> touchedSegments;
+            MailboxSegment* segment = nullptr;
+            frames.reserve(frames.length() + found->second.numBytes);
+
+            for(const MailboxEntry& entry : entries)
+            {
+
+                if(touchedSegments.empty() || touchedSegments.back() != entry.segment)
+                {
+
+                    segment = &m_segments[entry.segment];
+                    touchedSegments.push_back(entry.segment);
+
+                }
+
+                char* record = segment->data + entry.offset;
+                frames.append(record + sizeof(MailboxRecordHeader) + recipient.length(), entry.payloadSize);
+                reinterpret_cast<MailboxRecordHeader*>(record)->state = MAILBOX_RECORD_DELIVERED;
+                segment->liveBytes -= entry.recordSize;
+
+            }
+
+            const size_t numTaken = entries.size();
+            m_numQueued -= numTaken;
+            m_mailboxes.erase(found);
+
+            std::sort(touchedSegments.begin(), touchedSegments.end());
+            touchedSegments.erase(std::unique(touchedSegments.begin(), touchedSegments.end()), touchedSegments.end());
+
+            for(uint32_t number : touchedSegments) { compactLocked(number); }
+
+            return numTaken;
+
+        }
+
+        // GetNumQueued() returns the number of messages waiting across every mailbox.
+        size_t getNumQueued()
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            return m_numQueued;
+
+        }
+
+        // GetNumSegments() returns the number of segment files in use.
+        size_t getNumSegments()
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            return m_segments.size();
+
+        }
+};
@@ -0,0 +1,190 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+using std::string;
+
+// The priority class of an outbound frame. A connection always sends everything queued in a higher class (lower value)
+// before anything in a lower one.
+enum OutboundClass : uint8_t
+{
+
+    OUTBOUND_CONTROL, // Liveness pings and other server control frames.
+    OUTBOUND_UNICAST, // Private messages and notices addressed to this connection alone.
+    OUTBOUND_BROADCAST, // Room traffic. The only class that is shed under overload.
+    OUTBOUND_BULK, // File transfer chunks. Never shed; the flow control window of each transfer bounds them instead.
+    OUTBOUND_NUM_CLASSES
+
+};
+
+// OutboundQueue holds the frames a connection could not take yet, one FIFO per OutboundClass. It only exists while a
+// connection is backlogged, and is only ever touched by the fanout shard that owns the connection.
+//
+// Frames are shared, so a broadcast queued on thousands of slow connections is held in memory once.
+class OutboundQueue
+{
+
+    public:
+
+        inline static const OutboundClass SHED_CLASS = OUTBOUND_BROADCAST; // The class dropped under overload.
+        inline static const size_t DEFAULT_SHED_THRESHOLD = 256 * 1024; // Once this many bytes other than OUTBOUND_BULK are queued, frames of SHED_CLASS are dropped.
+        inline static const size_t DEFAULT_MAX_QUEUED_BYTES = 1 << 20; // A connection with more than this queued has stopped reading, and is closed.
+
+    private:
+
+        std::deque<boost::shared_ptr<const string>> m_frames[OUTBOUND_NUM_CLASSES]; // The queued frames of each class.
+        boost::shared_ptr<const string> m_current; // The frame being written. Once started it is finished before any other, so frames never interleave.
+        OutboundClass m_currentClass; // The class of m_current.
+        size_t m_currentOffset; // The bytes of m_current already written.
+        size_t m_queuedBytes; // The bytes not written yet, including the remainder of m_current.
+        size_t m_bulkBytes; // The part of m_queuedBytes in OUTBOUND_BULK; left out of the shed threshold, as file transfers bound it themselves.
+        std::atomic<size_t>* m_totalBytes; // A counter shared by every OutboundQueue of a ConnectionSlab, kept in step with m_queuedBytes.
+
+        // AddBytes(numBytes, priority) adjusts m_queuedBytes, and m_totalBytes with it, by numBytes of the class, priority.
+        void addBytes(ptrdiff_t numBytes, OutboundClass priority)
+        {
+
+            m_queuedBytes += numBytes;
+            *m_totalBytes += numBytes;
+
+            if(priority == OUTBOUND_BULK) { m_bulkBytes += numBytes; }
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        OutboundQueue(const OutboundQueue& rhs) = delete;
+        OutboundQueue& operator=(const OutboundQueue& rhs) = delete;
+
+        // One-parameter constructor that reports the queued bytes to totalBytes.
+        explicit OutboundQueue(std::atomic<size_t>* totalBytes) noexcept : m_currentClass{OUTBOUND_CONTROL}, m_currentOffset{0}, m_queuedBytes{0}, m_bulkBytes{0}, m_totalBytes{totalBytes} {}
+
+        // Destructor that discards whatever is still queued.
+        ~OutboundQueue()
+        {
+
+            *m_totalBytes -= m_queuedBytes;
+
+        }
+
+        // StartWith(frame, priority, offset) queues the remainder of a frame of the class, priority, whose first offset bytes
+        // were already written. The queue must be empty.
+        void startWith(const boost::shared_ptr<const string>& frame, OutboundClass priority, size_t offset)
+        {
+
+            m_current = frame;
+            m_currentClass = priority;
+            m_currentOffset = offset;
+            addBytes(frame->size() - offset, priority);
+
+        }
+
+        // Push(frame, priority, shedThreshold) queues frame in the class, priority, and returns the number of SHED_CLASS frames
+        // dropped to stay under shedThreshold bytes; this includes frame itself if it is of SHED_CLASS and arrived over the
+        // threshold. Other classes are never dropped, and a control frame identical to the last one queued is collapsed into it.
+        // OUTBOUND_BULK frames neither count toward shedThreshold nor make room for themselves, so a connection receiving files
+        // still gets its room traffic.
+        size_t push(const boost::shared_ptr<const string>& frame, OutboundClass priority, size_t shedThreshold = DEFAULT_SHED_THRESHOLD)
+        {
+
+            std::deque<boost::shared_ptr<const string>>& frames = m_frames[priority];
+
+            if(priority == OUTBOUND_CONTROL && !frames.empty() && *frames.back() == *frame) { return 0; }
+
+            if(priority == SHED_CLASS && m_queuedBytes - m_bulkBytes >= shedThreshold) { return 1; }
+
+            size_t numShed = 0;
+            std::deque<boost::shared_ptr<const string>>& shedFrames = m_frames[SHED_CLASS];
+
+            // Make room for a higher class frame by dropping the oldest frames of SHED_CLASS.
+            while(m_queuedBytes - m_bulkBytes + frame->size() > shedThreshold && priority < SHED_CLASS && !shedFrames.empty())
+            {
+
+                addBytes(-static_cast<ptrdiff_t>(shedFrames.front()->size()), SHED_CLASS);
+                shedFrames.pop_front();
+                numShed++;
+
+            }
+
+            frames.push_back(frame);
+            addBytes(frame->size(), priority);
+            return numShed;
+
+        }
+
+        // Peek(length) returns the unwritten bytes of the next frame to write, and stores their number in length. It returns
+        // nullptr once nothing is queued.
+        const char* peek(size_t& length)
+        {
+
+            if(m_current.get() == nullptr)
+            {
+
+                for(uint8_t priority = 0; priority < OUTBOUND_NUM_CLASSES; priority++)
+                {
+
+                    std::deque<boost::shared_ptr<const string>>& frames = m_frames[priority];
+
+                    if(frames.empty()) { continue; }
+
+                    m_current = frames.front();
+                    m_currentClass = static_cast<OutboundClass>(priority);
+                    m_currentOffset = 0;
+                    frames.pop_front();
+                    break;
+
+                }
+
+                if(m_current.get() == nullptr) { return nullptr; }
+
+            }
+
+            length = m_current->size() - m_currentOffset;
+            return m_current->data() + m_currentOffset;
+
+        }
+
+        // Advance(numBytes) marks numBytes of the frame returned by peek(..) as written. It returns that frame if this
+        // completed it, or nullptr. The returned frame is only good for comparison; it may already be gone.
+        const string* advance(size_t numBytes)
+        {
+
+            m_currentOffset += numBytes;
+            addBytes(-static_cast<ptrdiff_t>(numBytes), m_currentClass);
+
+            if(m_currentOffset < m_current->size()) { return nullptr; }
+
+            const string* completed = m_current.get();
+            m_current.reset();
+            return completed;
+
+        }
+
+        // GetQueuedBytes() returns the number of bytes not written yet.
+        inline size_t getQueuedBytes() const noexcept
+        {
+
+            return m_queuedBytes;
+
+        }
+
+        // GetBulkBytes() returns the part of getQueuedBytes() in OUTBOUND_BULK.
+        inline size_t getBulkBytes() const noexcept
+        {
+
+            return m_bulkBytes;
+
+        }
+
+        // GetQueuedFrames(priority) returns the number of frames queued in the class, priority, not counting one being written.
+        inline size_t getQueuedFrames(OutboundClass priority) const noexcept
+        {
+
+            return m_frames[priority].size();
+
+        }
+};
@@ -17,5 +17,16 @@ class PacketTagTypes
         inline const static std::string PKT_MESSAGE{"%m%"};
         inline const static std::string PKT_PING{"%p%"};
         inline const static std::string PKT_PM{"%v%"};
+        inline const static std::string PKT_SHM{"%s%"};
+        inline const static std::string PKT_TRACE{"%t%"};
+        inline const static std::string PKT_SEARCH{"%q%"};
+        inline const static std::string PKT_FILE_OFFER{"%o%"};
+        inline const static std::string PKT_FILE_ACCEPT{"%a%"};
+        inline const static std::string PKT_FILE_DATA{"%d%"};
+        inline const static std::string PKT_FILE_ACK{"%k%"};
+        inline const static std::string PKT_FILE_COMPLETE{"%c%"};
+        inline const static std::string PKT_IGNORE{"%i%"};
+        inline const static std::string PKT_UNIGNORE{"%u%"};
+        inline const static std::string PKT_RETRY{"%r%"};
 
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include <iostream>
+#include "TraceReplayer.cpp"
+#include <stdlib.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+int main(int argc, char* argv[])
+{
+
+    if(argc != 4 && argc != 5)
+    {
+
+        cerr << "Usage: <trace file> <host> <port> [speed | max]" << endl;
+        return 1;
+
+    }
+
+    // A speed of 1 replays in real time, N replays N times faster and "max" replays as fast as possible.
+    double speed = 1;
+
+    if(argc == 5)
+    {
+
+        speed = string(argv[4]) == "max" ? 0 : strtod(argv[4], nullptr);
+
+    }
+
+    char* port_ptr;
+    TraceReplayer replayer{argv[2], static_cast<unsigned int>(strtol(argv[3], &port_ptr, 10)), speed};
+
+    if(!replayer.load(argv[1]))
+    {
+
+        cerr << "Unable to load trace file: " << argv[1] << endl;
+        return 1;
+
+    }
+
+    replayer.run();
+    return 0;
+
+}
\ No newline at end of file
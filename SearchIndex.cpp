@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+using std::string;
+
+// SearchResult is a message matched by SearchIndex::search(..).
+struct SearchResult
+{
+
+    uint64_t messageId; // The position of the message among every message ever indexed.
+    string content;
+
+};
+
+// SearchIndex is an incremental inverted index over relayed messages. Messages are handed to add(..), which only queues
+// them; a background thread tokenizes them and appends their ids to the posting list of each term.
+//
+// The index is split into generations of GENERATION_SIZE consecutive messages, each with its own posting lists, stored
+// as varint-encoded deltas between message offsets. Retention drops whole generations, oldest first, so old messages
+// expire without rewriting any posting list. A query intersects the posting lists of its terms one generation at a time,
+// newest first, and stops as soon as it has enough results.
+class SearchIndex
+{
+
+    public:
+
+        inline static const uint32_t GENERATION_SIZE = 1 << 16; // The number of messages in each generation.
+        inline static const size_t MAX_GENERATIONS = 32; // Retain at most the most recent MAX_GENERATIONS * GENERATION_SIZE messages...
+        inline static const size_t MAX_RETAINED_BYTES = 256 << 20; // ...and at most this much message text.
+        inline static const size_t MAX_PENDING = 1 << 16; // Messages waiting to be indexed beyond this many are dropped, not waited for.
+        inline static const size_t INDEX_BATCH_SIZE = 256; // The most messages indexed per hold of the index lock, so queries are not held up.
+        inline static const size_t MAX_TERM_LENGTH = 32; // Longer terms are truncated to this length.
+        inline static const size_t MAX_QUERY_TERMS = 8; // Terms of a query beyond this many are ignored.
+
+    private:
+
+        // PostingList is the list of the messages of a generation that contain a term.
+        struct PostingList
+        {
+
+            string deltas; // The offset of each message, as the varint-encoded difference from the previous offset.
+            uint32_t lastOffset; // The offset of the last message in the list.
+            uint32_t count; // The number of messages in the list.
+
+        };
+
+        // Generation holds the text and posting lists of GENERATION_SIZE consecutive messages.
+        struct Generation
+        {
+
+            uint64_t firstId; // The id of the first message; the message at offset k has the id firstId + k.
+            string text; // The content of every message, back to back.
+            std::vector<uint32_t> ends; // The end of each message within text.
+            boost::unordered_map<string, PostingList> postings; // The posting list of every term.
+
+        };
+
+        std::deque<Generation*> m_generations; // The retained generations, oldest first.
+        uint64_t m_nextId; // The id of the next message indexed.
+        size_t m_retainedBytes; // The text held by m_generations.
+        boost::shared_mutex m_indexMutex; // Guards the members above. Held exclusively while indexing, and shared while searching.
+        std::vector<string> m_pending; // Messages waiting to be indexed.
+        boost::mutex m_pendingMutex; // Guards m_pending.
+        boost::condition_variable m_wakeup; // Signalled when m_pending becomes non-empty or the indexer stops.
+        std::atomic<bool> m_running; // The running status of the indexer thread.
+        std::atomic<uint64_t> m_numDropped; // The number of messages dropped because too many were waiting.
+        boost::thread m_thread; // The indexer thread.
+
+        // AppendVarint(out, value) appends value to out, 7 bits per byte, least significant first.
+        static inline void appendVarint(string& out, uint32_t value)
+        {
+
+            while(value >= 0x80)
+            {
+
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+
+            }
+
+            out.push_back(static_cast<char>(value));
+
+        }
+
+        // Decode(list, offsets) replaces offsets with the offsets in list, in increasing order.
+        static void decode(const PostingList& list, std::vector<uint32_t>& offsets)
+        {
+
+            const uint8_t* position = reinterpret_cast<const uint8_t*>(list.deltas.data());
+            uint32_t offset = 0;
+            offsets.resize(list.count);
+
+            for(uint32_t index = 0; index < list.count; index++)
+            {
+
+                uint32_t delta = 0;
+
+                for(int shift = 0; ; shift += 7)
+                {
+
+                    delta |= static_cast<uint32_t>(*position & 0x7f) << shift;
+
+                    if((*position++ & 0x80) == 0) { break; }
+
+                }
+
+                offset += delta;
+                offsets[index] = offset;
+
+            }
+        }
+
+        // Tokenize(content, terms) replaces terms with the distinct terms of content: its runs of letters and digits, in
+        // lower case.
+        static void tokenize(const string& content, std::vector<string>& terms)
+        {
+
+            terms.clear();
+
+            for(size_t index = 0; index < content.length(); )
+            {
+
+                if(!isalnum(static_cast<unsigned char>(content[index]))) { index++; continue; }
+
+                string term;
+
+                for(; index < content.length() && isalnum(static_cast<unsigned char>(content[index])); index++)
+                {
+
+                    if(term.length() < MAX_TERM_LENGTH) { term.push_back(static_cast<char>(tolower(static_cast<unsigned char>(content[index])))); }
+
+                }
+
+                if(std::find(terms.begin(), terms.end(), term) == terms.end()) { terms.push_back(term); }
+
+            }
+        }
+
+        // IndexLocked(content, terms) adds content, whose terms have been found by tokenize(..), to the newest generation,
+        // and drops the generations past retention. m_indexMutex must be held exclusively.
+        void indexLocked(const string& content, const std::vector<string>& terms)
+        {
+
+            if(m_generations.empty() || m_generations.back()->ends.size() == GENERATION_SIZE)
+            {
+
+                Generation* generation = new Generation;
+                generation->firstId = m_nextId;
+                m_generations.push_back(generation);
+
+            }
+
+            Generation& generation = *m_generations.back();
+            const uint32_t offset = generation.ends.size();
+            generation.text.append(content);
+            generation.ends.push_back(generation.text.length());
+            m_retainedBytes += content.length();
+            m_nextId++;
+
+            for(const string& term : terms)
+            {
+
+                PostingList& list = generation.postings[term];
+                appendVarint(list.deltas, list.count == 0 ? offset : offset - list.lastOffset);
+                list.lastOffset = offset;
+                list.count++;
+
+            }
+
+            while(m_generations.size() > MAX_GENERATIONS || (m_retainedBytes > MAX_RETAINED_BYTES && m_generations.size() > 1))
+            {
+
+                m_retainedBytes -= m_generations.front()->text.length();
+                delete m_generations.front();
+                m_generations.pop_front();
+
+            }
+        }
+
+        // RunIndexer() is the body of the indexer thread. It takes every pending message at once and indexes them in
+        // batches of INDEX_BATCH_SIZE.
+        void runIndexer()
+        {
+
+            std::vector<string> batch;
+            std::vector<string> terms;
+
+            for(;;)
+            {
+
+                {
+
+                    boost::unique_lock<boost::mutex> lock{m_pendingMutex};
+
+                    while(m_pending.empty() && m_running) { m_wakeup.wait(lock); }
+
+                    if(m_pending.empty()) { return; }
+
+                    batch.swap(m_pending);
+
+                }
+
+                for(size_t start = 0; start < batch.size(); start += INDEX_BATCH_SIZE)
+                {
+
+                    const size_t end = std::min(batch.size(), start + INDEX_BATCH_SIZE);
+                    boost::unique_lock<boost::shared_mutex> lock{m_indexMutex};
+
+                    for(size_t index = start; index < end; index++)
+                    {
+
+                        tokenize(batch[index], terms);
+                        indexLocked(batch[index], terms);
+
+                    }
+                }
+
+                batch.clear();
+
+            }
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        SearchIndex(const SearchIndex& rhs) = delete;
+        SearchIndex& operator=(const SearchIndex& rhs) = delete;
+
+        // Default constructor. Messages are only indexed once start() is called.
+        SearchIndex() noexcept : m_nextId{0}, m_retainedBytes{0}, m_running{false}, m_numDropped{0} {}
+
+        // Destructor that stops the indexer thread and frees the index.
+        ~SearchIndex()
+        {
+
+            stop();
+
+            for(Generation* generation : m_generations) { delete generation; }
+
+        }
+
+        // Start() starts the indexer thread.
+        void start()
+        {
+
+            if(m_running.exchange(true)) { return; }
+
+            m_thread = boost::thread{boost::bind(&SearchIndex::runIndexer, this)};
+
+        }
+
+        // Stop() indexes every pending message, then stops the indexer thread.
+        void stop()
+        {
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_pendingMutex};
+                m_running = false;
+
+            }
+
+            m_wakeup.notify_all();
+
+            if(m_thread.joinable()) { m_thread.join(); }
+
+        }
+
+        // Add(content) queues content to be indexed, and returns at once. If too many messages are already waiting, content
+        // is dropped instead.
+        void add(const string& content)
+        {
+
+            bool wasEmpty;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_pendingMutex};
+
+                if(m_pending.size() >= MAX_PENDING)
+                {
+
+                    m_numDropped++;
+                    return;
+
+                }
+
+                wasEmpty = m_pending.empty();
+                m_pending.push_back(content);
+
+            }
+
+            if(wasEmpty) { m_wakeup.notify_one(); }
+
+        }
+
+        // Search(query, maxResults, results) replaces results with at most maxResults of the most recent retained messages
+        // that contain every term of query, newest first. Messages still waiting to be indexed are not found.
+        void search(const string& query, size_t maxResults, std::vector<SearchResult>& results)
+        {
+
+            std::vector<string> terms;
+            tokenize(query, terms);
+            results.clear();
+
+            if(terms.size() > MAX_QUERY_TERMS) { terms.resize(MAX_QUERY_TERMS); }
+
+            if(terms.empty() || maxResults == 0) { return; }
+
+            std::vector<const PostingList*> lists(terms.size());
+            std::vector<uint32_t> matches;
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> intersection;
+            boost::shared_lock<boost::shared_mutex> lock{m_indexMutex};
+
+            for(std::deque<Generation*>::reverse_iterator itr = m_generations.rbegin(); itr != m_generations.rend() && results.size() < maxResults; itr++)
+            {
+
+                const Generation& generation = **itr;
+                bool missing = false;
+
+                for(size_t index = 0; index < terms.size() && !missing; index++)
+                {
+
+                    boost::unordered_map<string, PostingList>::const_iterator found = generation.postings.find(terms[index]);
+                    missing = found == generation.postings.end();
+                    lists[index] = missing ? nullptr : &found->second;
+
+                }
+
+                if(missing) { continue; }
+
+                // Intersect the shortest list with each longer one in turn, so the candidates only ever shrink.
+                std::sort(lists.begin(), lists.end(), [](const PostingList* lhs, const PostingList* rhs) { return lhs->count < rhs->count; });
+                decode(*lists[0], matches);
+
+                for(size_t index = 1; index < lists.size() && !matches.empty(); index++)
+                {
+
+                    decode(*lists[index], offsets);
+                    intersection.clear();
+                    std::set_intersection(matches.begin(), matches.end(), offsets.begin(), offsets.end(), std::back_inserter(intersection));
+                    matches.swap(intersection);
+
+                }
+
+                for(std::vector<uint32_t>::reverse_iterator match = matches.rbegin(); match != matches.rend() && results.size() < maxResults; match++)
+                {
+
+                    const uint32_t begin = *match == 0 ? 0 : generation.ends[*match - 1];
+                    results.push_back(SearchResult{generation.firstId + *match, generation.text.substr(begin, generation.ends[*match] - begin)});
+
+                }
+            }
+        }
+
+        // GetNumRetained() returns the number of messages that can currently be found.
+        uint64_t getNumRetained()
+        {
+
+            boost::shared_lock<boost::shared_mutex> lock{m_indexMutex};
+            return m_generations.empty() ? 0 : m_nextId - m_generations.front()->firstId;
+
+        }
+
+        // GetNumDropped() returns the number of messages that were never indexed because too many were waiting.
+        inline uint64_t getNumDropped() const noexcept
+        {
+
+            return m_numDropped.load();
+
+        }
+};
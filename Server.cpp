@@ -3,13 +3,33 @@
 #include <string>
 #include <boost/asio.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 // USER DEFINED IMPORTS
 #include "PacketTagTypes.cpp"
+#include "Logger.cpp"
+#include "Session.cpp"
+#include "ShmSession.cpp"
+#include "TraceCapture.cpp"
+#include "ConnectionSlab.cpp"
+#include "FanoutPool.cpp"
+#include "FrameScanner.cpp"
+#include "LatencyTracer.cpp"
+#include "OfflineMailbox.cpp"
+#include "SearchIndex.cpp"
+#include "FileTransferTable.cpp"
+#include "IgnoreTable.cpp"
+#include "AdmissionController.cpp"
+#include "ServerConfig.cpp"
+#include "CpuTopology.cpp"
 
 using namespace boost::asio;
 using ip::tcp;
@@ -20,286 +40,976 @@ using std::endl;
 
 typedef unsigned int uint;
 
-struct User
+class Server
 {
 
-    string host;
-    string nickname;
-    boost::shared_ptr<tcp::socket> tcpSocket;
+    private:
+
+        inline static const uint DEFAULT_MAX_CONNECTIONS = 1 << 17; // The number of connection slots preallocated by default.
+        inline static const size_t READER_STACK_SIZE = 32 * 1024; // Reader threads only parse frames, so they get a small stack.
+        inline static const uint32_t READ_CHUNK_SIZE = 2048; // The free space guaranteed in a receive buffer before each read.
+        inline static const size_t SEARCH_MAX_RESULTS = 10; // The most messages returned for a single search.
+        inline static const uint32_t LOAD_SAMPLE_INTERVAL_MS = 100; // How often the accept loop samples its lag and accept queue for m_admission.
+
+        string m_hostName; // The hostname that this Server object is running on.
+        uint m_portNum; // The port number that this Server object is binded to.
+        string m_localSocketPath; // The path of the Unix domain socket that this Server object listens on. Empty if disabled.
+        boost::scoped_ptr<tcp::acceptor> m_acceptor; // TCP acceptor scoped pointer.
+        boost::scoped_ptr<local::stream_protocol::acceptor> m_localAcceptor; // Unix domain socket acceptor scoped pointer.
+        boost::scoped_ptr<io_service> m_ioService; // Scoped pointer to the TCP IO Service that is embedded within @see m_acceptor.
+        boost::scoped_ptr<deadline_timer> m_loadSampleTimer; // Fires every LOAD_SAMPLE_INTERVAL_MS on m_ioService (@see sampleLoad(..)).
+        ConnectionSlab m_slab; // The state of every connection, preallocated. Declared after m_ioService so it is destroyed first.
+        boost::unordered_map<string, ConnectionHandle> userPoolMap; // A hashmap from the nickname of each joined user to its connection.
+        mutable boost::recursive_mutex m_userPoolMutex; // Guards userPoolMap and the fields of occupied slots shared between threads.
+        uint64_t m_numJoins; // The number of users that have joined; guarded by m_userPoolMutex, so a private message stored offline can tell if its recipient joined meanwhile.
+        std::atomic<bool> m_running; // True between connect() and disconnect().
+        ServerConfigStore m_config; // The tunable settings, which may change while the server runs (@see getConfig()).
+        std::atomic<uint> m_nextConnectionId; // The id handed to the next accepted connection.
+        std::atomic<uint> m_numReaderThreads; // The number of reader threads currently alive.
+        TraceCapture m_capture; // Records every inbound frame while a capture is in progress (@see startCapture(..)).
+        FanoutPool m_fanout; // The shards that write to connections. Declared after m_slab so it is stopped before the slots go away.
+        std::vector<std::vector<ConnectionHandle>> m_backlogged; // The connections of each fanout shard with an OutboundQueue; only touched on behalf of that shard.
+        std::atomic<uint64_t> m_outboundDrops[OUTBOUND_NUM_CLASSES]; // The number of frames dropped, per OutboundClass, because a connection could not keep up.
+        LatencyTracer m_tracer; // Times a sample of messages through every hop while tracing (@see startTracing(..)).
+        OfflineMailbox m_mailbox; // Holds private messages to users that are offline until they join (@see openMailbox(..)).
+        SearchIndex m_search; // Indexes relayed messages on its own thread, for PKT_SEARCH queries.
+        FileTransferTable m_transfers; // The file transfers being relayed between connections.
+        IgnoreTable m_ignores; // The nicknames each connection ignores, and who ignores each nickname.
+        AdmissionController m_admission; // Decides whether new connections are admitted, from the load of the server.
+        ThreadPlacement m_placement; // The CPUs the accept, fanout and reader threads are pinned to (@see setThreadPlacement(..)).
+
+        // CaptureFrame(connectionId, data) records the frame, data, if a capture is in progress.
+        void captureFrame(uint connectionId, const string& data)
+        {
+
+            if(!m_capture.isActive() || data.length() < 3) { return; }
+
+            m_capture.record(connectionId, data[1], data.data() + 3, data.length() - 4);
+
+        }
+
+        // ApplyConfig(config) applies the settings of config that are not read where they are used.
+        void applyConfig(const ServerConfig& config)
+        {
+
+            Logger::getInstance().setLevel(config.logLevel);
+            m_fanout.setFlushRetryInterval(config.flushRetryMs);
+
+            if(config.version > 1) { Logger::getInstance().log(LOG_INFO, "[Server]: Configuration version {} is in force.", config.version); }
+
+        }
+
+        // CloseConnection(slot) shuts down the transport of slot. Its reader thread then notices and has the slot released by
+        // its fanout shard, which closes and deletes the session, so its descriptor is never released (and reused) from
+        // under a blocking read or write.
+        void closeConnection(ConnectionSlot& slot)
+        {
+
+            if(slot.session != nullptr)
+            {
+
+                slot.session->shutdown();
+
+            }
+        }
+
+        // RemoveConnection(handle) removes the user of handle from userPoolMap and has its slot released. Only the reader
+        // thread of handle calls this.
+        void removeConnection(const ConnectionHandle& handle)
+        {
+
+            boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+            ConnectionSlot* slot = m_slab.get(handle);
+
+            if(slot == nullptr) { return; }
+
+            if(slot->joined)
+            {
+
+                const string& nickname = slot->getNickname();
+                userPoolMap.erase(nickname);
+                Logger::getInstance().log(LOG_INFO, "[Server]: {} has left.", nickname);
+
+            }
+
+            m_capture.record(slot->connectionId, TRACE_EVENT_DISCONNECT, nullptr, 0);
+            m_ignores.clear(handle.index);
+
+            // Let the other end of every transfer in progress know it will not finish.
+            std::vector<FileTransfer> transfers;
+            m_transfers.closeAll(handle, transfers);
+
+            for(const FileTransfer& transfer : transfers)
+            {
+
+                packetSend_Unicast(transfer.sender == handle ? transfer.recipient : transfer.sender, PacketTagTypes::PKT_FILE_COMPLETE + std::to_string(transfer.id) + " cancelled;");
+
+            }
+
+            // The slot is released by its owning shard, after every write already queued for it.
+            const FanoutJob job{FANOUT_RELEASE, nullptr, handle, ConnectionHandle{}, OUTBOUND_CONTROL};
+
+            if(!m_fanout.tryRunInline(job)) { m_fanout.postUnicast(job); }
+
+        }
+
+        // StartSyncRead(handle, incomingCpu) starts a synchronous read to check for any incoming data from the transport of
+        // the connection, handle, until it disconnects. The connection is then released. The reader is pinned as close to
+        // incomingCpu, where the kernel receives the packets of the connection, as m_placement allows.
+        void startSyncRead(ConnectionHandle handle, int incomingCpu)
+        {
+
+            m_numReaderThreads++;
+
+            // A log ring per reader would cost more than the rest of an idle connection put together.
+            Logger::getInstance().shareBuffer();
+            CpuTopology::pinCurrentThread(m_placement.readerCpusFor(incomingCpu));
+
+            while(m_running && handleSocketRead(handle))
+            {
+
+                // A connection moving a file reads without pausing, so the transfer is not held to a chunk per pause.
+                if(!m_transfers.isTransferring(handle)) { boost::this_thread::sleep(boost::posix_time::milliseconds(m_config.current().readIntervalMs)); }
+
+            }
+
+            removeConnection(handle);
+            m_numReaderThreads--;
+
+        }
+
+        // HandleSocketRead(handle) performs a synchronous read on the transport of the connection, handle, and handles every
+        // complete frame received. It returns false once the connection should be dropped.
+        bool handleSocketRead(const ConnectionHandle& handle)
+        {
+
+            ConnectionSlot* slot;
+
+            {
+
+                boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+                slot = m_slab.get(handle);
+
+            }
+
+            if(slot == nullptr) { return false; }
+
+            // Wait for data before taking a receive buffer, so an idle connection does not hold one.
+            boost::system::error_code error;
+            slot->session->waitReadable(error);
+
+            if(error) { return false; }
+
+            char* readPos = m_slab.reserveIoBuffer(*slot, READ_CHUNK_SIZE);
+
+            if(readPos == nullptr) { return false; }
+
+            const size_t numBytes = slot->session->readSome(boost::asio::buffer(readPos, slot->ioBufferCapacity - slot->ioBufferLength), error);
+
+            if(error) { return false; }
+
+            // While tracing, note when these bytes reached the kernel and when they were read.
+            const int64_t received = m_tracer.isActive() ? LatencyTracer::now() : 0;
+            const int64_t arrived = received != 0 ? slot->session->getLastArrivalTime() : 0;
+
+            // Find every frame boundary in the bytes just read; the bytes pending from earlier reads hold none.
+            static thread_local std::vector<uint32_t> boundaries;
+            boundaries.clear();
+            FrameScanner::scan(slot->ioBuffer, slot->ioBufferLength, slot->ioBufferLength + numBytes, ';', boundaries);
+            slot->ioBufferLength += numBytes;
+
+            // Handle every complete frame in the receive buffer; an incomplete trailing frame stays for the next read.
+            uint32_t frameStart = 0;
+
+            for(const uint32_t frameEnd : boundaries)
+            {
+
+                if(!handleFrame(handle, *slot, string(slot->ioBuffer + frameStart, frameEnd + 1 - frameStart), arrived, received)) { return false; }
+
+                frameStart = frameEnd + 1;
+
+            }
+
+            m_slab.consume(*slot, frameStart);
+            return true;
+
+        }
+
+        // HandleFrame(handle, slot, data, arrived, received) handles a single frame, data, received on the connection, handle.
+        // While tracing, arrived and received are when its bytes reached the kernel and were read. It returns false if the
+        // connection should be dropped. Data is taken by value so a relayed frame can be handed on without a copy.
+        bool handleFrame(const ConnectionHandle& handle, ConnectionSlot& slot, string data, int64_t arrived, int64_t received)
+        {
+
+            if(data.length() < 4) { return true; }
+
+            string tag = data.substr(0, 3);
+            captureFrame(slot.connectionId, data);
+
+            if(!slot.joined)
+            {
+
+                return handleHandshakeFrame(handle, slot, data);
+
+            }
+
+            if(tag == PacketTagTypes::PKT_MESSAGE)
+            {
+                
+                // Message bodies are only logged at LOG_DEBUG; at the default level relaying one logs nothing.
+                const string& content = data.substr(3, data.length() - 4);
+                Logger::getInstance().log(LOG_DEBUG, "{}", content);
+                const uint32_t traceId = received != 0 ? m_tracer.sample(slot.connectionId, arrived, received) : 0;
+
+                // Skip the peers that ignore the sender. While nobody ignores anybody there is no mask to look up.
+                const IgnoreMaskPtr& mutedBy = m_ignores.isEmpty() ? IgnoreMaskPtr{} : m_ignores.mutedBy(slot.getNickname());
+                packetSend_Broadcast(ConnectionHandle{}, data, OUTBOUND_BROADCAST, traceId, mutedBy);
+                m_search.add(content);
+                
+            }
+            else if(tag == PacketTagTypes::PKT_SEARCH)
+            {
+
+                // Reply (through unicasting) with the most recent messages that contain every term of the query, newest first.
+                const string& query = data.substr(3, data.length() - 4);
+                std::vector<SearchResult> results;
+                m_search.search(query, SEARCH_MAX_RESULTS, results);
+
+                string reply = tag + "[Search]: " + (results.empty() ? "No" : std::to_string(results.size())) + " recent messages match '" + query + "'.;";
+
+                for(const SearchResult& result : results)
+                {
+
+                    reply += tag + "  " + result.content + ";";
+
+                }
+
+                packetSend_Unicast(handle, reply);
+
+            }
+            else if(tag == PacketTagTypes::PKT_IGNORE || tag == PacketTagTypes::PKT_UNIGNORE)
+            {
+
+                // Update the ignore list of this connection, and confirm the result (through unicasting).
+                const string& nickname = data.substr(3, data.length() - 4);
+                string reply;
+
+                if(nickname.empty() || nickname == slot.getNickname())
+                {
+
+                    reply = "You cannot ignore yourself!";
+
+                }
+                else if(tag == PacketTagTypes::PKT_UNIGNORE)
+                {
+
+                    reply = m_ignores.unignore(handle.index, nickname) ? "You are no longer ignoring '" + nickname + "'." : "You were not ignoring '" + nickname + "'.";
+
+                }
+                else
+                {
+
+                    const IgnoreResult result = m_ignores.ignore(handle.index, nickname);
+                    reply = result == IGNORE_FULL ? "You cannot ignore more than " + std::to_string(IgnoreTable::MAX_IGNORED) + " users!" : "You are now ignoring '" + nickname + "'.";
+
+                }
+
+                packetSend_Unicast(handle, tag + "[Server]: " + reply + ";");
+
+            }
+            else if(tag == PacketTagTypes::PKT_TRACE)
+            {
+
+                // A Client reporting the arrival of a traced message.
+                m_tracer.acked(static_cast<uint32_t>(strtoul(data.c_str() + 3, nullptr, 10)));
+
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_OFFER || tag == PacketTagTypes::PKT_FILE_ACCEPT || tag == PacketTagTypes::PKT_FILE_DATA
+                    || tag == PacketTagTypes::PKT_FILE_ACK || tag == PacketTagTypes::PKT_FILE_COMPLETE)
+            {
+
+                handleFileFrame(handle, slot, tag, data);
+
+            }
+            else if(tag == PacketTagTypes::PKT_PM)
+            {
+
+                const size_t nicknameNextWSIndex = data.find(' ', 3);
+
+                if(nicknameNextWSIndex == string::npos) { return true; }
+
+                const string targetNickname = data.substr(3, nicknameNextWSIndex - 3);
+                const string& targetMessage = "From [" + slot.getNickname() + "]: " + data.substr(nicknameNextWSIndex + 1, data.length() - nicknameNextWSIndex - 2);
+
+                // No user can ever join under a nickname that is empty or too long, so there is nobody to queue the message for.
+                if(targetNickname.empty() || targetNickname.length() > ConnectionSlot::MAX_NICKNAME_LENGTH)
+                {
+
+                    packetSend_Unicast(handle, tag + "User '" + targetNickname + "' does not exist!;");
+                    return true;
+
+                }
+
+                uint64_t numJoins;
+
+                {
+
+                    boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+                    boost::unordered_map<string, ConnectionHandle>::const_iterator target = userPoolMap.find(targetNickname);
+
+                    if(target != userPoolMap.end() && m_ignores.isIgnoring(target->second.index, slot.getNickname()))
+                    {
+
+                        // The targeted user ignores the issuer of this command, so the message is silently dropped.
+                        Logger::getInstance().log(LOG_INFO, "[Server]: Dropped a private message to {}, who ignores {}.", targetNickname, slot.getNickname());
+                        return true;
+
+                    }
+
+                    if(target != userPoolMap.end())
+                    {
+
+                        // Send the private message to the transport of the correct user through unicasting.
+                        Logger::getInstance().log(LOG_DEBUG, "{}", targetMessage);
+                        packetSend_Unicast(target->second, tag + targetMessage + ";");
+                        return true;
+
+                    }
+
+                    numJoins = m_numJoins;
+
+                }
+
+                // Queue the private message for when the targeted user joins, and alert the user (through unicasting) that issued
+                // this command. The mailbox writes to disk, so this happens outside m_userPoolMutex.
+                string offlineMessage = "User '" + targetNickname + "' is not currently online!";
+
+                if(m_mailbox.store(targetNickname, tag + targetMessage + ";"))
+                {
+
+                    offlineMessage = "User '" + targetNickname + "' is not currently online. They will receive your message when they join.";
+
+                    // The targeted user may have joined, and taken their mailbox, while the message was being stored.
+                    ConnectionHandle joined;
+
+                    {
+
+                        boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+
+                        if(m_numJoins != numJoins && userPoolMap.count(targetNickname) > 0) { joined = userPoolMap[targetNickname]; }
+
+                    }
+
+                    if(joined.isValid()) { deliverMail(joined, targetNickname); }
+
+                }
+                else if(m_mailbox.isOpen())
+                {
+
+                    offlineMessage = "User '" + targetNickname + "' is not currently online, and their mailbox is full!";
+
+                }
+
+                Logger::getInstance().log(LOG_INFO, "{}", offlineMessage);
+                packetSend_Unicast(handle, tag + offlineMessage + ";");
+            }
+
+            return true;
+
+        }
+
+        // DeliverMail(handle, nickname) delivers every private message queued for nickname while offline to the connection,
+        // handle, in one write.
+        void deliverMail(const ConnectionHandle& handle, const string& nickname)
+        {
+
+            string mail;
+            const size_t numMail = m_mailbox.take(nickname, mail);
+
+            if(numMail > 0)
+            {
+
+                packetSend_Unicast(handle, mail);
+                Logger::getInstance().log(LOG_INFO, "[Server]: Delivered {} queued private messages to {}.", numMail, nickname);
+
+            }
+        }
+
+        // HandleFileFrame(handle, slot, tag, data) relays a frame, data, of the file transfer protocol (@see FileChunkCodec)
+        // sent by the connection, handle. Chunks are handed on in the buffer they arrived in, at the lowest priority, so a
+        // transfer only ever uses what chat traffic leaves of a connection.
+        void handleFileFrame(const ConnectionHandle& handle, ConnectionSlot& slot, const string& tag, string& data)
+        {
+
+            char* fieldEnd;
+            const uint32_t id = static_cast<uint32_t>(strtoul(data.c_str() + 3, &fieldEnd, 10));
+            ConnectionHandle peer;
+
+            if(tag == PacketTagTypes::PKT_FILE_DATA)
+            {
+
+                const ChunkRelayResult result = m_transfers.relayChunk(id, handle, static_cast<uint32_t>(strtoul(fieldEnd, nullptr, 10)), peer);
+
+                if(result == CHUNK_RELAY)
+                {
+
+                    packetSend_Unicast(peer, boost::make_shared<const string>(std::move(data)), OUTBOUND_BULK);
+
+                }
+                else if(result == CHUNK_VIOLATION)
+                {
+
+                    const string& failed = PacketTagTypes::PKT_FILE_COMPLETE + std::to_string(id) + " failed;";
+                    packetSend_Unicast(handle, failed);
+                    packetSend_Unicast(peer, failed);
+
+                }
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_ACK)
+            {
+
+                if(m_transfers.acknowledge(id, handle, static_cast<uint32_t>(strtoul(fieldEnd, nullptr, 10)), peer)) { packetSend_Unicast(peer, data); }
+
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_ACCEPT)
+            {
+
+                if(m_transfers.accept(id, handle, peer)) { packetSend_Unicast(peer, data); }
+
+            }
+            else if(tag == PacketTagTypes::PKT_FILE_COMPLETE)
+            {
+
+                if(m_transfers.close(id, handle, peer)) { packetSend_Unicast(peer, data); }
+
+            }
+            else
+            {
+
+                // An offer names the recipient, followed by the size and name of the file, which are passed on as they are.
+                const size_t recipientEnd = data.find(' ', 3);
+
+                if(recipientEnd == string::npos) { return; }
+
+                const string recipient = data.substr(3, recipientEnd - 3);
+                const string& details = data.substr(recipientEnd + 1, data.length() - recipientEnd - 2);
+                boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+                boost::unordered_map<string, ConnectionHandle>::const_iterator found = userPoolMap.find(recipient);
+                const uint32_t transferId = found == userPoolMap.end() ? 0 : m_transfers.open(handle, found->second);
+
+                packetSend_Unicast(handle, tag + std::to_string(transferId) + " to " + recipient + " " + details + ";");
+
+                if(transferId == 0)
+                {
+
+                    const string& refusal = found == userPoolMap.end() ? "User '" + recipient + "' is not currently online!"
+                                                                       : "[Server]: You or '" + recipient + "' already have too many file transfers in progress.";
+                    packetSend_Unicast(handle, PacketTagTypes::PKT_PM + refusal + ";");
+                    return;
+
+                }
+
+                packetSend_Unicast(found->second, tag + std::to_string(transferId) + " from " + slot.getNickname() + " " + details + ";");
+                Logger::getInstance().log(LOG_INFO, "[Server]: {} offered {} a file ({}).", slot.getNickname(), recipient, details);
+
+            }
+        }
+
+        // HandleHandshakeFrame(handle, slot, data) handles a frame received before the connection, handle, has sent its
+        // nickname. It returns false if the connection should be dropped.
+        bool handleHandshakeFrame(const ConnectionHandle& handle, ConnectionSlot& slot, const string& data)
+        {
+
+            const string& tag = data.substr(0, 3);
+
+            if(tag == PacketTagTypes::PKT_NICKNAME)
+            {
+
+                const string& nickname = data.substr(3, data.length() - 4);
+                string rejection;
+
+                {
+
+                    boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+
+                    if(nickname.empty() || !slot.setNickname(nickname))
+                    {
+
+                        rejection = "[Server]: Nicknames must be between 1 and " + std::to_string(ConnectionSlot::MAX_NICKNAME_LENGTH) + " characters.";
+
+                    }
+                    else if(userPoolMap.count(nickname) > 0)
+                    {
+
+                        rejection = "[Server]: The nickname '" + nickname + "' is already in use.";
+
+                    }
+                    else
+                    {
+
+                        slot.joined = true;
+                        userPoolMap.emplace(nickname, handle);
+                        m_numJoins++;
+
+                    }
+                }
+
+                if(!rejection.empty())
+                {
+
+                    boost::system::error_code ignored;
+                    slot.session->write(boost::asio::buffer(PacketTagTypes::PKT_MESSAGE + rejection + ";"), ignored);
+                    return false;
+
+                }
+
+                packetSend_Broadcast(handle, PacketTagTypes::PKT_MESSAGE + "[Server]: " + nickname + " joined!;");
+
+                deliverMail(handle, nickname);
+
+                if(slot.session->getTransportName() == "tcp")
+                {
+
+                    Logger::getInstance().log(LOG_INFO, "[Server]: {} joined!", nickname);
+
+                }
+                else
+                {
+
+                    Logger::getInstance().log(LOG_INFO, "[Server]: {} joined! ({})", nickname, slot.session->getTransportName());
+
+                }
+            }
+            else if(tag == PacketTagTypes::PKT_SHM && slot.session->getTransportName() == "unix")
+            {
+
+                // A local client asked to move its traffic onto a shared-memory ring pair. The Unix domain socket
+                // it connected with stays open as the control channel of the new session.
+                const string& segmentName = data.substr(3, data.length() - 4);
+                ShmRingPair* rings = new ShmRingPair;
+
+                try
+                {
+
+                    // Only a segment created by the connecting user may be opened (and so unlinked).
+                    struct ucred peer;
+                    socklen_t length = sizeof(peer);
+
+                    if(getsockopt(static_cast<LocalSession*>(slot.session)->getSocket().native_handle(), SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0)
+                    {
+
+                        throw std::runtime_error{"ShmRingPair: unable to identify the client of " + segmentName};
+
+                    }
+
+                    rings->open(segmentName, peer.uid);
+
+                }
+                catch(const std::exception& e)
+                {
+
+                    delete rings;
+                    Logger::getInstance().log(LOG_WARN, "[Server]: {}", e.what());
+                    return false;
+
+                }
+
+                boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+                boost::shared_ptr<LocalSession> control{static_cast<LocalSession*>(slot.session)};
+                slot.session = new ShmSession{rings, control};
+
+            }
+
+            return true;
+
+        }
+
+        // StartAsyncAccept() configures an asynchronous callback for a future connected client.
+        void startAsyncAccept()
+        {
+
+            if(m_ioService.get() == nullptr || m_acceptor.get() == nullptr) { return; }
+
+            TcpSession* clientSocket = new TcpSession{*m_ioService};
+            m_acceptor->async_accept(clientSocket->getSocket(), boost::bind(&Server::handleAsyncAccept, this, clientSocket, boost::asio::placeholders::error));
+
+        }
+
+        // RunAcceptLoop() starts accepting TCP clients and runs the embedded io_service object.
+        void runAcceptLoop()
+        {
+
+            CpuTopology::pinCurrentThread(m_placement.acceptCpus);
+            startAsyncAccept();
+            m_loadSampleTimer->expires_from_now(boost::posix_time::milliseconds(LOAD_SAMPLE_INTERVAL_MS));
+            m_loadSampleTimer->async_wait(boost::bind(&Server::sampleLoad, this, boost::asio::placeholders::error));
+            m_ioService->run();
+
+        }
+
+        // SampleLoad(error) is a callback for m_loadSampleTimer. It records for m_admission how late the timer fired, which is
+        // how far behind the accept loop is, and the depth of the accept queue of the TCP acceptor.
+        void sampleLoad(const boost::system::error_code& error)
+        {
+
+            if(error || !m_running) { return; }
+
+            const boost::posix_time::time_duration& lag = boost::posix_time::microsec_clock::universal_time() - m_loadSampleTimer->expires_at();
+            m_admission.record(ADMISSION_LOOP_LAG, std::max<int64_t>(0, lag.total_milliseconds()));
+
+            // For a listening socket, the kernel reports the connections waiting to be accepted as tcpi_unacked.
+            struct tcp_info info;
+            socklen_t length = sizeof(info);
+
+            if(m_acceptor.get() != nullptr && getsockopt(m_acceptor->native_handle(), IPPROTO_TCP, TCP_INFO, &info, &length) == 0)
+            {
+
+                m_admission.record(ADMISSION_ACCEPT_QUEUE, info.tcpi_unacked);
+
+            }
+
+            m_loadSampleTimer->expires_from_now(boost::posix_time::milliseconds(LOAD_SAMPLE_INTERVAL_MS));
+            m_loadSampleTimer->async_wait(boost::bind(&Server::sampleLoad, this, boost::asio::placeholders::error));
+
+        }
+
+        // HandleAsyncAccept(clientSocket, error) is a callback for the result of an async_accept call. It hands clientSocket
+        // to a reader thread and immediately accepts the next client.
+        void handleAsyncAccept(TcpSession* clientSocket, const boost::system::error_code& error)
+        {
+
+            if(error)
+            {
+
+                delete clientSocket;
+                return;
+
+            }
+
+            handleNewSession(clientSocket);
+            startAsyncAccept();
+
+        }
+
+        // StartLocalAccept() synchronously accepts clients on the Unix domain socket at m_localSocketPath until the
+        // acceptor is closed. Same-host clients skip the TCP/IP stack entirely and may upgrade to a shared-memory ring pair.
+        void startLocalAccept()
+        {
+
+            CpuTopology::pinCurrentThread(m_placement.acceptCpus);
 
-    User() = default;
-    User(const string& host_, const string& nick_) : host{host_}, nickname{nick_} {}
+            while(m_localAcceptor.get() != nullptr && m_localAcceptor->is_open())
+            {
 
-};
+                LocalSession* clientSocket = new LocalSession{*m_ioService};
+                boost::system::error_code error;
+                m_localAcceptor->accept(clientSocket->getSocket(), error);
 
-class Server
-{
+                if(error)
+                {
 
-    private:
+                    delete clientSocket;
+                    return;
 
-        string m_hostName; // The hostname that this Server object is running on.
-        uint m_portNum; // The port number that this Server object is binded to.
-        boost::scoped_ptr<tcp::acceptor> m_acceptor; // TCP acceptor scoped pointer.
-        boost::scoped_ptr<io_service> m_ioService; // Scoped pointer to the TCP IO Service that is embedded within @see m_acceptor.
-        boost::unordered_map<string, User> userPoolMap; // A hashmap that stores the state of each connected user.
+                }
 
-        // StartSyncRead(user) starts a synchronous read to check for any incoming data from the TCP socket that is binded to
-        // the user object.
-        void startSyncRead(User& user)
-        {
+                handleNewSession(clientSocket);
 
-            if(m_ioService.get() == nullptr) { return; }
+            }
+        }
+
+        // RejectSession(session, retryAfterMs, reason) tells a session that was not admitted to try again in retryAfterMs, and
+        // why, then closes it.
+        void rejectSession(Session* session, uint32_t retryAfterMs, const string& reason)
+        {
 
-            handleSocketRead(user);
-            boost::this_thread::sleep(boost::posix_time::milliseconds(250));
-            startSyncRead(user);
+            boost::system::error_code ignored;
+            session->write(boost::asio::buffer(PacketTagTypes::PKT_RETRY + std::to_string(retryAfterMs) + " " + reason + ";"), ignored);
+            delete session;
 
         }
 
-        // HandleSocketRead(socketPtr, args) performs a synchronous read on the deferenced value of socketPtr. Additionally,
-        // this overload provides args to store miscellaneous data (such as nickname inside the scoped_ptr object).
-        void handleSocketRead(boost::shared_ptr<tcp::socket>& socketPtr, boost::scoped_ptr<string>& args)
+        // HandleNewSession(session) places a newly accepted session in a connection slot and starts its reader thread, which
+        // performs the nickname handshake. This is shared by every transport. While the server is overloaded, the session is
+        // rejected instead, before it costs a slot or a thread.
+        void handleNewSession(Session* session)
         {
 
-            boost::asio::streambuf buf;
+            uint32_t retryAfterMs = 0;
+            AdmissionSignal signal = ADMISSION_CONNECTIONS;
+            const bool wasOverloaded = m_admission.isOverloaded();
+            const bool admitted = m_admission.admit(m_config.current().admission, m_slab.getNumInUse(), m_slab.getOutboundBytes(), retryAfterMs, signal);
 
-            try
+            if(wasOverloaded != m_admission.isOverloaded())
             {
 
-                boost::asio::read_until(*socketPtr, buf, ";");
+                if(admitted) { Logger::getInstance().log(LOG_INFO, "[Server]: Load has recovered; admitting new connections again."); }
+                else { Logger::getInstance().log(LOG_INFO, "[Server]: Overloaded ({}); rejecting new connections.", AdmissionController::nameOf(signal)); }
 
             }
-            catch(const std::exception& e)
+
+            if(!admitted)
             {
 
+                rejectSession(session, retryAfterMs, "[Server]: The server is busy.");
                 return;
 
             }
 
-            string data = boost::asio::buffer_cast<const char*>(buf.data());
-            string tag = data.substr(0, 3);
+            if(m_tracer.isActive()) { session->enableArrivalTimestamps(); }
 
-            if(tag == PacketTagTypes::PKT_NICKNAME)
+            const int incomingCpu = session->getIncomingCpu();
+
+            const ConnectionHandle& handle = m_slab.allocate(session, m_nextConnectionId++);
+
+            if(!handle.isValid())
             {
 
-                const string& host = socketPtr->local_endpoint().address().to_string();
-                const string& nickname = data.substr(3, data.length() - 4);
-                User newUser{host, nickname};
-                newUser.tcpSocket = socketPtr;
-                userPoolMap.emplace(nickname, newUser);
-                args.reset(new string{nickname});
+                rejectSession(session, AdmissionController::MAX_RETRY_MS, "[Server]: The server is full.");
+                return;
 
             }
+
+            boost::thread::attributes attrs;
+            attrs.set_stack_size(READER_STACK_SIZE);
+            boost::thread readerThread{attrs, boost::bind(&Server::startSyncRead, this, handle, incomingCpu)};
+            readerThread.detach();
+
         }
 
-        // HandleSocketRead(user) performs a synchronous read on the TCP socket binded to User object, user.
-        void handleSocketRead(User& user)
-        {
+        // Synchronous handlers
 
-            boost::asio::streambuf buf;
-            boost::shared_ptr<tcp::socket>& socketPtr = user.tcpSocket;
+        // StartSyncPing() broadcasts a synchronous ping packet to all connected clients. It executes every 250ms
+        // while the application is running to maintain real-time connectivity updates. 
+        void startSyncPing()
+        {
 
-            try
+            while(m_running)
             {
 
-                boost::asio::read_until(*socketPtr, buf, ";");
+                packetSend_Broadcast(ConnectionHandle{}, PacketTagTypes::PKT_PING + ";", OUTBOUND_CONTROL);
+                boost::this_thread::sleep(boost::posix_time::milliseconds(m_config.current().pingIntervalMs));
 
             }
-            catch(const std::exception& e)
-            {
+        }
 
-                return;
+        // Packet casting methods.
 
-            }
+        // PacketSend_Unicast(handle, message, priority) writes a single packet to the connection, handle, with a content of
+        // message. The packet is queued in the class, priority, if the connection cannot take it yet.
+        void packetSend_Unicast(const ConnectionHandle& handle, const string& message, OutboundClass priority = OUTBOUND_UNICAST)
+        {
 
-            string data = boost::asio::buffer_cast<const char*>(buf.data());
-            string tag = data.substr(0, 3);
+            packetSend_Unicast(handle, boost::make_shared<const string>(message), priority);
 
-            if(tag == PacketTagTypes::PKT_MESSAGE)
-            {
-                
-                string content;
+        }
 
-                if(data[data.length() - 1] != ';')
-                {
+        // PacketSend_Unicast(handle, frame, priority) writes the packet, frame, to the connection, handle, without copying it.
+        void packetSend_Unicast(const ConnectionHandle& handle, const boost::shared_ptr<const string>& frame, OutboundClass priority)
+        {
 
-                    uint terminatorIndex = data.length() - 1;
+            const FanoutJob job{FANOUT_UNICAST, frame, handle, ConnectionHandle{}, priority};
 
-                    while(data[--terminatorIndex] != ';') {}
-                                                                  
-                    content = data.substr(3, terminatorIndex - 3);
+            if(!m_fanout.tryRunInline(job)) { m_fanout.postUnicast(job); }
 
-                }
-                else
-                {
+        }
 
-                    content = data.substr(3, data.length() - 4);
+        // PacketSend_Broadcast(exclude, message, priority, traceId, mutedBy) writes a packet containing the content of message to
+        // every joined peer, except the peer, exclude, and the peers in mutedBy. Large broadcasts are split across the fanout
+        // shards; every shard shares the same copy of message. The packet is queued in the class, priority, on connections that
+        // cannot take it yet. If traceId is set, message is followed by a trace marker that asks every recipient to report its
+        // arrival.
+        void packetSend_Broadcast(const ConnectionHandle& exclude, const string& message, OutboundClass priority = OUTBOUND_BROADCAST, uint32_t traceId = 0,
+                                  const IgnoreMaskPtr& mutedBy = IgnoreMaskPtr{})
+        {
 
-                }
+            const FanoutJob job{FANOUT_BROADCAST, boost::make_shared<const string>(message), ConnectionHandle{}, exclude, priority, traceId, mutedBy};
 
-                cout << content << endl;
-                packetSend_Broadcast("", data);
-                
-            }
-            else if(tag == PacketTagTypes::PKT_PM)
-            {
+            if(traceId != 0) { m_tracer.enqueued(traceId, job.message); }
 
-                
-                uint nicknameNextWSIndex = 3;
+            if(!(m_slab.getNumInUse() <= m_config.current().inlineFanoutLimit && m_fanout.tryRunInline(job))) { m_fanout.postBroadcast(job); }
 
-                while(data[nicknameNextWSIndex] != ' ')
-                {
+            if(traceId != 0) { packetSend_Broadcast(exclude, PacketTagTypes::PKT_TRACE + std::to_string(traceId) + ";", priority, 0, mutedBy); }
 
-                    nicknameNextWSIndex++;
+        }
 
-                }
+        // DeliverFanoutJob(shard, job) performs job for the connections owned by shard. It only ever runs on the thread of
+        // shard, or inline while every shard is idle, so a connection is never written to by two threads at once.
+        void deliverFanoutJob(uint32_t shard, const FanoutJob& job)
+        {
 
-                const string targetNickname = data.substr(3, nicknameNextWSIndex - 3);
+            if(job.type == FANOUT_BROADCAST)
+            {
+
+                const uint32_t highWater = m_slab.getHighWater();
+                const IgnoreMask* mutedBy = job.mutedBy.get();
 
-                if(userPoolMap.count(targetNickname) == 0)
+                // Iterate through every slot owned by this shard that has ever been occupied.
+                for(uint32_t index = shard; index < highWater; index += m_fanout.getNumShards())
                 {
 
-                    // Alert the user (through unicasting) that issued this command that the targeted user is not online (or connected to the server)
-                    // to send a private message.
-                    const string& offlineMessage = "User '" + targetNickname + "' is not currently online!";
-                    cout << offlineMessage << endl;
-                    packetSend_Unicast(user, tag + offlineMessage + ";");
+                    ConnectionSlot& slot = m_slab.at(index);
 
-                }
-                else
-                {
+                    // Skip free slots, connections still in their handshake and the peer we wish to exclude.
+                    if(!slot.inUse || !slot.joined || index == job.exclude.index) { continue; }
+
+                    // Skip the peers that ignore the sender.
+                    if(mutedBy != nullptr && mutedBy->test(index)) { continue; }
 
-                    // Send the private message to the TCP socket of the correct user through unicasting.
-                    const string& targetMessage = "From [" + user.nickname + "]: " + data.substr(nicknameNextWSIndex + 1);
-                    cout << targetMessage << endl;
-                    packetSend_Unicast(userPoolMap[targetNickname], tag + targetMessage + ";");
+                    writeToSlot(shard, m_slab.handleOf(index), slot, job.message, job.priority, job.traceId);
 
                 }
             }
-        }
+            else if(job.type == FANOUT_UNICAST)
+            {
 
-        // StartAsyncAccept() configures an asynchronous callback for a future connected client and runs the embedded io_service
-        // object.
-        void startAsyncAccept()
-        {
+                ConnectionSlot* slot = m_slab.get(job.target);
 
-            if(m_ioService.get() == nullptr) { return; }
+                if(slot != nullptr) { writeToSlot(shard, job.target, *slot, job.message, job.priority, job.traceId); }
 
-            boost::shared_ptr<tcp::socket> clientSocket{new tcp::socket{*m_ioService}};
-            m_acceptor->async_accept(*clientSocket, bind(&Server::handleAsyncAccept, this, clientSocket));
-            m_ioService->run();
+            }
+            else if(job.type == FANOUT_RELEASE)
+            {
+
+                boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+                m_slab.release(job.target);
 
+            }
         }
 
-        // HandleAsyncAccept(clientSocket) is a callback for the result of an async_accept call. It requests information from
-        // clientSocket and broadcasts a notification message to all other connected clients. 
-        void handleAsyncAccept(boost::shared_ptr<tcp::socket>& clientSocket)
+        // WriteToSlot(shard, handle, slot, message, priority, traceId) writes message to the transport of slot without blocking.
+        // Whatever the transport cannot take yet is queued in the class, priority, and retried by shard (@see flushBacklogged(..)).
+        void writeToSlot(uint32_t shard, const ConnectionHandle& handle, ConnectionSlot& slot, const boost::shared_ptr<const string>& message, OutboundClass priority, uint32_t traceId)
         {
 
-            if(clientSocket.get() == nullptr) { return; }
+            if(slot.outbound != nullptr)
+            {
+
+                // Frames are already waiting, so this one waits its turn.
+                OutboundQueue& queue = *slot.outbound;
+                const ServerConfig& config = m_config.current();
+                const size_t numShed = queue.push(message, priority, config.shedThresholdBytes);
 
-            boost::scoped_ptr<string> nickname_ptr;
-            handleSocketRead(clientSocket, nickname_ptr); 
-            packetSend_Broadcast(*nickname_ptr, PacketTagTypes::PKT_MESSAGE + "[Server]: " + *nickname_ptr + " joined!;");
-            boost::thread readerThread{boost::bind(&Server::startSyncRead, this, userPoolMap[*nickname_ptr])};
-            cout << "[Server]: " + *nickname_ptr + " joined!" << endl;
-            startAsyncAccept();
+                if(numShed > 0) { m_outboundDrops[OutboundQueue::SHED_CLASS] += numShed; }
 
-        }
+                if(queue.getQueuedBytes() > config.maxQueuedBytes)
+                {
 
-        // Synchronous handlers
+                    Logger::getInstance().log(LOG_WARN, "[Server]: {} stopped reading; closing the connection.", slot.getNickname());
+                    dropOutbound(slot);
+                    closeConnection(slot);
 
-        // StartSyncPing() broadcasts a synchronous ping packet to all connected clients. It executes every 250ms
-        // while the application is running to maintain real-time connectivity updates. 
-        void startSyncPing()
-        {
+                }
+
+                return;
 
-            if(m_ioService.get() == nullptr) { return; }
+            }
 
-            packetSend_Broadcast("", PacketTagTypes::PKT_PING + ";");
-            boost::this_thread::sleep(boost::posix_time::milliseconds(250));
-            startSyncPing();
+            boost::system::error_code status;
+            const size_t numBytes = slot.session->tryWrite(boost::asio::buffer(*message), status);
 
-        }
+            // Check if an error occurred, if so close this connection; its reader thread removes it from userPoolMap.
+            if(status && status != boost::asio::error::would_block)
+            {
 
-        // Packet casting methods.
+                closeConnection(slot);
+                return;
+
+            }
+
+            if(numBytes == message->size())
+            {
+
+                if(traceId != 0) { m_tracer.written(traceId); }
+
+                return;
 
-        // PacketSend_Unicast(targetClient, message) writes a single packet to the targetClient with a content of message.
-        void packetSend_Unicast(User& user, const string& message)
+            }
+
+            m_slab.createOutboundQueue(slot).startWith(message, priority, numBytes);
+            m_backlogged[shard].push_back(handle);
+            m_fanout.requestFlush(shard);
+
+        }
+
+        // FlushBacklogged(shard) retries the writes of every backlogged connection of shard. It returns true if some are
+        // still backlogged.
+        bool flushBacklogged(uint32_t shard)
         {
 
-            try
+            std::vector<ConnectionHandle>& backlogged = m_backlogged[shard];
+
+            for(size_t index = 0; index < backlogged.size();)
             {
 
-                boost::system::error_code status;
-                boost::asio::write(*user.tcpSocket, boost::asio::buffer(message), status);
+                ConnectionSlot* slot = m_slab.get(backlogged[index]);
 
-                if(status == boost::asio::error::connection_reset || status == boost::asio::error::broken_pipe)
+                if(slot == nullptr || slot->outbound == nullptr || flushSlot(*slot))
                 {
 
-                    if(userPoolMap.count(user.nickname) > 0)
-                    {
+                    backlogged[index] = backlogged.back();
+                    backlogged.pop_back();
+                    continue;
 
-                        userPoolMap[user.nickname].tcpSocket.reset();
-                        userPoolMap.erase(user.nickname);
-                    }
                 }
+
+                index++;
+
             }
-            catch(const boost::system::system_error& err)
-            { }
+
+            return !backlogged.empty();
 
         }
 
-        // PacketSend_Broadcast(nickname, message) writes a packet containing the content of message to every peer, except the peer
-        // named nickname.
-        void packetSend_Broadcast(const string& nickname, const string& message)
+        // FlushSlot(slot) writes as much of the OutboundQueue of slot as its transport takes, control frames first. It returns
+        // true once the queue is gone, either because it drained or because the connection failed.
+        bool flushSlot(ConnectionSlot& slot)
         {
 
-            std::vector<string> blacklist_nicknames; // A string vector of clients that have lost connection. These users should be removed
-                                                     // from userPoolMap and resource handles should appropriately be deallocated.
+            OutboundQueue& queue = *slot.outbound;
+            size_t length;
 
-            // Iterate through key-value pairs contained within userPoolMap.
-            for(auto& p : userPoolMap)
+            while(const char* data = queue.peek(length))
             {
 
-                // If the nickname of this user is the one we wish to include (nickname), then skip this iteration.
-                if(p.first == nickname) { continue; }
+                boost::system::error_code status;
+                const size_t numBytes = slot.session->tryWrite(boost::asio::buffer(data, length), status);
 
-                try
-                {
+                if(status == boost::asio::error::would_block) { return false; }
 
-                    // Attempt to synchronously write to this users tcp socket.
-                    boost::system::error_code status;
-                    boost::asio::write(*p.second.tcpSocket, boost::asio::buffer(message), status);
+                if(status)
+                {
 
-                    // Check if an error occurred, if so this user should be removed from userPoolMap following this loop.
-                    if(status == boost::asio::error::connection_reset || status == boost::asio::error::broken_pipe)
-                    {
-                        
-                        cout << "[Server]: " << p.first << " has left." << endl;
-                        blacklist_nicknames.push_back(p.first);
+                    m_slab.destroyOutboundQueue(slot);
+                    closeConnection(slot);
+                    return true;
 
-                    }
                 }
-                catch(const boost::system::system_error& err)
-                { }
+
+                const string* completed = queue.advance(numBytes);
+
+                if(completed != nullptr) { m_tracer.frameWritten(completed); }
+
             }
 
-            // Any user contained in blacklist_nicknames should be removed from the server's cache.
-            // Iterate through this list and do this accordingly.
-            for(auto itr = blacklist_nicknames.begin(); itr != blacklist_nicknames.end(); itr++)
-            {
+            m_slab.destroyOutboundQueue(slot);
+            return true;
 
-                const string& nickname = *itr;
-               
-                if(userPoolMap.count(nickname) > 0)
-                {
+        }
 
-                    userPoolMap[nickname].tcpSocket.reset();
-                    userPoolMap.erase(nickname);
+        // DropOutbound(slot) discards the OutboundQueue of slot, counting every frame in it as dropped.
+        void dropOutbound(ConnectionSlot& slot)
+        {
+
+            for(uint priority = 0; priority < OUTBOUND_NUM_CLASSES; priority++)
+            {
+
+                m_outboundDrops[priority] += slot.outbound->getQueuedFrames(static_cast<OutboundClass>(priority));
 
-                }
             }
+
+            m_slab.destroyOutboundQueue(slot);
+
         }
 
     public:
@@ -313,26 +1023,23 @@ class Server
         Server& operator=(const Server&& rhs) = delete;
 
         // Two-parameter constructor that accepts a host name and port number as input; these values are
-        // initialized to the appropriate variable.
-        explicit Server(const string& host, const uint& port) noexcept : m_hostName{host}, m_portNum{port}, m_acceptor{nullptr}, m_ioService{nullptr} {}
-
-        // Destructor for cleaning up resources.
-        ~Server()
+        // initialized to the appropriate variable. If localSocketPath is not empty, the server will additionally accept
+        // same-host clients on a Unix domain socket at that path. The server starts with the settings, config.
+        explicit Server(const string& host, const uint& port, const string& localSocketPath = "", const ServerConfig& config = ServerConfig{}) : m_hostName{host}, m_portNum{port}, m_localSocketPath{localSocketPath}, m_acceptor{nullptr}, m_localAcceptor{nullptr}, m_ioService{nullptr}, m_slab{DEFAULT_MAX_CONNECTIONS}, m_numJoins{0}, m_running{false}, m_config{config}, m_nextConnectionId{0}, m_numReaderThreads{0}, m_fanout{config.fanoutThreads != 0 ? config.fanoutThreads : boost::thread::hardware_concurrency()}, m_backlogged(m_fanout.getNumShards()), m_outboundDrops{}
         {
 
-            m_acceptor.reset();
-            m_ioService.reset();
+            applyConfig(m_config.current());
+            m_config.onChange(boost::bind(&Server::applyConfig, this, boost::placeholders::_1));
 
-            for(auto& p : userPoolMap)
-            {
+        }
 
-                if(p.second.tcpSocket.get() != nullptr)
-                {
+        // Destructor for cleaning up resources.
+        ~Server()
+        {
 
-                    p.second.tcpSocket.reset();
+            disconnect();
+            m_localAcceptor.reset();
 
-                }
-            }
         }
 
         // Connect() trys to establish a connection to host, m_hostName, and port, m_portNum.
@@ -344,11 +1051,34 @@ class Server
                 
                 
                 m_ioService.reset(new io_service);
+                m_running = true;
+                m_search.start();
+                m_fanout.start(boost::bind(&Server::deliverFanoutJob, this, boost::placeholders::_1, boost::placeholders::_2), boost::bind(&Server::flushBacklogged, this, boost::placeholders::_1), m_placement.fanoutCpus);
                 m_acceptor.reset(new tcp::acceptor{*m_ioService, tcp::endpoint(boost::asio::ip::address::from_string(m_hostName), m_portNum)});
+                m_loadSampleTimer.reset(new deadline_timer{*m_ioService});
                 cout << "Connection established at [" << m_hostName << ", " << m_portNum << "]" << endl;
 
+                if(!m_placement.acceptCpus.empty() || !m_placement.fanoutCpus.empty() || !m_placement.readerCpus.empty())
+                {
+
+                    const CpuTopology& topology = CpuTopology::getInstance();
+                    Logger::getInstance().log(LOG_INFO, "[Server]: Pinning threads across {} CPUs on {} NUMA nodes.", topology.getOnlineCpus().size(), topology.getNumNodes());
+
+                }
+
                 // Start worker thread to check for incoming client connections asynchronously.
-                boost::thread asyncAcceptThread{boost::bind(&Server::startAsyncAccept, this)};
+                boost::thread asyncAcceptThread{boost::bind(&Server::runAcceptLoop, this)};
+
+                // Start worker thread to accept same-host clients on the Unix domain socket, if one was requested.
+                if(!m_localSocketPath.empty())
+                {
+
+                    ::unlink(m_localSocketPath.c_str());
+                    m_localAcceptor.reset(new local::stream_protocol::acceptor{*m_ioService, local::stream_protocol::endpoint(m_localSocketPath)});
+                    cout << "Local connections accepted at [" << m_localSocketPath << "]" << endl;
+                    boost::thread localAcceptThread{boost::bind(&Server::startLocalAccept, this)};
+
+                }
 
                 // Start worker thread to ping tcp sockets cached in userPoolMap. If we are unable to ping a user
                 // they've lost connection.
@@ -366,6 +1096,8 @@ class Server
         void disconnect()
         {
 
+            if(!m_running.exchange(false)) { return; }
+
             try
             {
 
@@ -377,22 +1109,142 @@ class Server
 
                 }
 
+                if(m_localAcceptor.get() != nullptr)
+                {
+
+                    m_localAcceptor->close();
+                    ::unlink(m_localSocketPath.c_str());
+
+                }
+
+                // Close every connection, which wakes its reader thread, and give the readers a moment to release their
+                // slots before the io_service their sockets belong to goes away.
+                {
+
+                    boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+
+                    for(uint32_t index = 0; index < m_slab.getHighWater(); index++)
+                    {
+
+                        if(m_slab.at(index).inUse) { closeConnection(m_slab.at(index)); }
+
+                    }
+                }
+
+                for(int attempt = 0; attempt < 100 && m_numReaderThreads > 0; attempt++)
+                {
+
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+
+                }
+
+                // Deliver what is still queued, including the releases of the slots just closed.
+                m_fanout.stop();
+                m_search.stop();
+
                 if(m_ioService.get() != nullptr)
                 {
 
                     m_ioService->stop();
-                    m_ioService.reset();
 
                 }
             }
             catch(const std::exception e)
             {
 
-                cerr << "[Server]: Server has shutdown." << endl;
+                Logger::getInstance().log(LOG_ERROR, "[Server]: Server has shutdown.");
             
             }
 
-            cout << "[Server]: Server has shutdown." << endl;
+            stopCapture();
+            Logger::getInstance().log(LOG_INFO, "[Server]: Server has shutdown.");
+            Logger::getInstance().flush();
+
+        }
+
+        // StartCapture(path, includeContent) records every inbound frame to a binary trace file at path, for offline replay.
+        // If includeContent is not set, only the size of each payload is kept. It returns false if the file could not be created.
+        bool startCapture(const string& path, bool includeContent)
+        {
+
+            return m_capture.start(path, includeContent);
+
+        }
+
+        // StopCapture() finishes the capture in progress, if any.
+        void stopCapture()
+        {
+
+            m_capture.stop();
+
+            if(m_capture.getNumDropped() > 0) { Logger::getInstance().log(LOG_WARN, "[Server]: The capture dropped {} records because the disk fell behind.", m_capture.getNumDropped()); }
+
+        }
+
+        // OpenMailbox(directory) keeps private messages to offline users in directory until they join, across restarts of
+        // the server. It returns false if the mailbox could not be opened.
+        bool openMailbox(const string& directory)
+        {
+
+            return m_mailbox.open(directory);
+
+        }
+
+        // SetThreadPlacement(placement) pins the accept, fanout and reader threads to the CPUs of placement. Reader threads
+        // are steered towards the CPU each connection's packets arrive on. It must be called before connect().
+        void setThreadPlacement(const ThreadPlacement& placement)
+        {
+
+            m_placement = placement;
+
+        }
+
+        // GetConfig() returns the settings of this Server object, through which they can be changed while it runs.
+        ServerConfigStore& getConfig() noexcept
+        {
+
+            return m_config;
+
+        }
+
+        // GetNumRejectedConnections() returns the number of connections rejected because the server was overloaded.
+        uint64_t getNumRejectedConnections() const noexcept
+        {
+
+            return m_admission.getNumRejected();
+
+        }
+
+        // GetNumMailboxMessages() returns the number of private messages waiting for offline users.
+        size_t getNumMailboxMessages()
+        {
+
+            return m_mailbox.getNumQueued();
+
+        }
+
+        // StartTracing(sampleEvery) times one relayed message out of every sampleEvery through each hop, from the kernel
+        // receiving it to its recipients reporting its arrival. Only connections accepted from now on report kernel arrival times.
+        void startTracing(uint32_t sampleEvery)
+        {
+
+            m_tracer.start(sampleEvery);
+
+        }
+
+        // StopTracing() stops tracing. What was traced stays available through getLatencyTracer().
+        void stopTracing()
+        {
+
+            m_tracer.stop();
+
+        }
+
+        // GetLatencyTracer() returns the per-stage latency histograms and trace records of this Server object.
+        LatencyTracer& getLatencyTracer() noexcept
+        {
+
+            return m_tracer;
 
         }
 
@@ -420,10 +1272,55 @@ class Server
 
         }
 
+        // GetConnectionMemoryStats() returns a breakdown of the memory spent on connections.
+        ConnectionMemoryStats getConnectionMemoryStats()
+        {
+
+            ConnectionMemoryStats stats = m_slab.getMemoryStats();
+
+            {
+
+                boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
+
+                for(uint32_t index = 0; index < m_slab.getHighWater(); index++)
+                {
+
+                    const ConnectionSlot& slot = m_slab.at(index);
+
+                    if(slot.inUse && slot.session != nullptr) { stats.sessionBytes += slot.session->getMemoryUsage(); }
+
+                }
+            }
+
+            stats.stackBytes = m_numReaderThreads * READER_STACK_SIZE;
+            stats.logBufferBytes = Logger::getInstance().getSharedBufferBytes();
+
+            if(stats.numConnections > 0)
+            {
+
+                stats.bytesPerConnection = (stats.slotBytes + stats.ioBufferBytes + stats.outboundBytes + stats.sessionBytes) / stats.numConnections;
+                stats.stackBytesPerConnection = stats.stackBytes / stats.numConnections;
+
+            }
+
+            return stats;
+
+        }
+
+        // GetOutboundDropCount(priority) returns the number of frames of the class, priority, dropped because the connection
+        // they were addressed to could not keep up.
+        inline uint64_t getOutboundDropCount(OutboundClass priority) const noexcept
+        {
+
+            return m_outboundDrops[priority].load();
+
+        }
+
         // GetNumConnections() returns the number of active connections.
         const uint inline getNumConnections() const noexcept
         {
 
+            boost::lock_guard<boost::recursive_mutex> lock{m_userPoolMutex};
             return userPoolMap.size();
 
         }
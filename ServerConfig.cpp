@@ -0,0 +1,339 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+// USER DEFINED IMPORTS
+#include "Logger.cpp"
+#include "OutboundQueue.cpp"
+#include "FanoutPool.cpp"
+#include "AdmissionController.cpp"
+
+using std::string;
+
+// ServerConfig is one version of the tunable settings of a Server. A published ServerConfig is never modified; a change
+// publishes a new one (@see ServerConfigStore).
+struct ServerConfig
+{
+
+    uint64_t version; // Increases by one with every change published.
+    uint32_t fanoutThreads; // The number of fanout shards, or 0 for one per core. Only read at startup.
+    uint32_t readIntervalMs; // How long a reader thread pauses between reads of its connection.
+    uint32_t pingIntervalMs; // How often every connection is pinged.
+    uint32_t flushRetryMs; // How often a fanout shard retries its backlogged connections.
+    uint32_t inlineFanoutLimit; // Broadcasts to at most this many connections skip the fanout shards when they are idle.
+    uint64_t shedThresholdBytes; // Once this many bytes other than file chunks are queued for a connection, broadcasts to it are dropped.
+    uint64_t maxQueuedBytes; // A connection with more than this queued has stopped reading, and is closed.
+    AdmissionLimits admission; // The load past which new connections are rejected.
+    LogLevel logLevel; // Log records below this level are discarded.
+
+    // Default constructor with the built-in settings.
+    ServerConfig() noexcept : version{1}, fanoutThreads{0}, readIntervalMs{250}, pingIntervalMs{250}, flushRetryMs{FanoutPool::DEFAULT_FLUSH_RETRY_MS},
+                              inlineFanoutLimit{64}, shedThresholdBytes{OutboundQueue::DEFAULT_SHED_THRESHOLD}, maxQueuedBytes{OutboundQueue::DEFAULT_MAX_QUEUED_BYTES},
+                              admission{{AdmissionController::DEFAULT_MAX_CONNECTIONS, AdmissionController::DEFAULT_MAX_OUTBOUND_BYTES, AdmissionController::DEFAULT_MAX_LOOP_LAG_MS,
+                              AdmissionController::DEFAULT_MAX_ACCEPT_QUEUE}}, logLevel{LOG_INFO} {}
+
+};
+
+// ServerConfigStore holds the ServerConfig in force, and publishes changes to it made through set(..) or reload().
+//
+// Readers call current(), which is a single atomic load, so hot paths can consult the settings on every use without a
+// lock. A change copies the current settings, applies itself to the copy, and swaps the copy in with a new version, so a
+// reader sees either every part of a change or none of it. Versions are kept until the store is destroyed, so a reference
+// returned by current() never dangles; changes are rare enough that the memory is negligible.
+//
+// Settings are written as "key = value" lines; '#' starts a comment.
+class ServerConfigStore
+{
+
+    public:
+
+        typedef boost::function<void(const ServerConfig& config)> ChangeFunction;
+
+    private:
+
+        // NumericKey is a setting whose value is a number from minimum to maximum.
+        struct NumericKey
+        {
+
+            const char* name;
+            uint64_t minimum;
+            uint64_t maximum;
+            uint64_t (*get)(const ServerConfig& config);
+            void (*set)(ServerConfig& config, uint64_t value);
+
+        };
+
+        inline static const char* LOG_LEVEL_NAMES[LOG_NUM_LEVELS] = {"debug", "info", "warn", "error"};
+
+        std::atomic<const ServerConfig*> m_current; // The settings in force.
+        std::vector<const ServerConfig*> m_versions; // Every version published, oldest first.
+        string m_path; // The file reload() reads, or empty.
+        ChangeFunction m_onChange; // Called with every version published. May be empty.
+        boost::mutex m_mutex; // Serialises changes.
+
+        // NumericKeys() returns the table of every numeric setting.
+        static const std::vector<NumericKey>& numericKeys()
+        {
+
+            static const std::vector<NumericKey> keys{
+                {"fanout_threads", 0, UINT32_MAX, [](const ServerConfig& c) -> uint64_t { return c.fanoutThreads; }, [](ServerConfig& c, uint64_t v) { c.fanoutThreads = v; }},
+                {"read_interval_ms", 0, UINT32_MAX, [](const ServerConfig& c) -> uint64_t { return c.readIntervalMs; }, [](ServerConfig& c, uint64_t v) { c.readIntervalMs = v; }},
+                {"ping_interval_ms", 1, UINT32_MAX, [](const ServerConfig& c) -> uint64_t { return c.pingIntervalMs; }, [](ServerConfig& c, uint64_t v) { c.pingIntervalMs = v; }},
+                {"flush_retry_ms", 1, UINT32_MAX, [](const ServerConfig& c) -> uint64_t { return c.flushRetryMs; }, [](ServerConfig& c, uint64_t v) { c.flushRetryMs = v; }},
+                {"inline_fanout_limit", 0, UINT32_MAX, [](const ServerConfig& c) -> uint64_t { return c.inlineFanoutLimit; }, [](ServerConfig& c, uint64_t v) { c.inlineFanoutLimit = v; }},
+                {"shed_threshold_bytes", 0, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.shedThresholdBytes; }, [](ServerConfig& c, uint64_t v) { c.shedThresholdBytes = v; }},
+                {"max_queued_bytes", 1, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.maxQueuedBytes; }, [](ServerConfig& c, uint64_t v) { c.maxQueuedBytes = v; }},
+                {"max_connections", 0, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.admission.limits[ADMISSION_CONNECTIONS]; }, [](ServerConfig& c, uint64_t v) { c.admission.limits[ADMISSION_CONNECTIONS] = v; }},
+                {"max_outbound_bytes", 0, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.admission.limits[ADMISSION_OUTBOUND_BYTES]; }, [](ServerConfig& c, uint64_t v) { c.admission.limits[ADMISSION_OUTBOUND_BYTES] = v; }},
+                {"max_loop_lag_ms", 0, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.admission.limits[ADMISSION_LOOP_LAG]; }, [](ServerConfig& c, uint64_t v) { c.admission.limits[ADMISSION_LOOP_LAG] = v; }},
+                {"max_accept_queue", 0, UINT64_MAX, [](const ServerConfig& c) -> uint64_t { return c.admission.limits[ADMISSION_ACCEPT_QUEUE]; }, [](ServerConfig& c, uint64_t v) { c.admission.limits[ADMISSION_ACCEPT_QUEUE] = v; }}
+            };
+
+            return keys;
+
+        }
+
+        // Trim(text) returns text without leading and trailing whitespace.
+        static string trim(const string& text)
+        {
+
+            const size_t first = text.find_first_not_of(" \t\r");
+            return first == string::npos ? "" : text.substr(first, text.find_last_not_of(" \t\r") + 1 - first);
+
+        }
+
+        // PublishLocked(next) makes next, with the next version, the settings in force. m_mutex must be held.
+        void publishLocked(ServerConfig next)
+        {
+
+            next.version = current().version + 1;
+            const ServerConfig* published = new ServerConfig(next);
+            m_versions.push_back(published);
+            m_current.store(published, std::memory_order_release);
+
+            if(m_onChange) { m_onChange(*published); }
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        ServerConfigStore(const ServerConfigStore& rhs) = delete;
+        ServerConfigStore& operator=(const ServerConfigStore& rhs) = delete;
+
+        // One-parameter constructor whose settings start as initial.
+        explicit ServerConfigStore(const ServerConfig& initial) : m_versions{new ServerConfig(initial)}
+        {
+
+            m_current.store(m_versions.back(), std::memory_order_release);
+
+        }
+
+        // Destructor that frees every version.
+        ~ServerConfigStore()
+        {
+
+            for(const ServerConfig* version : m_versions) { delete version; }
+
+        }
+
+        // Apply(config, key, value, error) sets the setting, key, of config to value. It returns false, and describes the
+        // problem in error, if either is not valid.
+        static bool apply(ServerConfig& config, const string& key, const string& value, string& error)
+        {
+
+            if(key == "log_level")
+            {
+
+                for(int level = 0; level < LOG_NUM_LEVELS; level++)
+                {
+
+                    if(value == LOG_LEVEL_NAMES[level])
+                    {
+
+                        config.logLevel = static_cast<LogLevel>(level);
+                        return true;
+
+                    }
+                }
+
+                error = "log_level must be debug, info, warn or error";
+                return false;
+
+            }
+
+            for(const NumericKey& numeric : numericKeys())
+            {
+
+                if(key != numeric.name) { continue; }
+
+                char* end;
+                errno = 0;
+                const uint64_t number = strtoull(value.c_str(), &end, 10);
+
+                if(value.empty() || *end != '\0' || errno != 0 || value[0] == '-' || number < numeric.minimum || number > numeric.maximum)
+                {
+
+                    error = key + " must be a whole number from " + std::to_string(numeric.minimum) + " to " + std::to_string(numeric.maximum);
+                    return false;
+
+                }
+
+                numeric.set(config, number);
+                return true;
+
+            }
+
+            error = "unknown setting '" + key + "'";
+            return false;
+
+        }
+
+        // ParseFile(path, config, error) applies every setting in the file at path to config. It returns false, and
+        // describes the first problem in error, if the file cannot be read or holds a setting that is not valid.
+        static bool parseFile(const string& path, ServerConfig& config, string& error)
+        {
+
+            std::ifstream file{path};
+
+            if(!file)
+            {
+
+                error = "unable to read " + path;
+                return false;
+
+            }
+
+            string line;
+
+            for(int lineNumber = 1; std::getline(file, line); lineNumber++)
+            {
+
+                line = trim(line.substr(0, line.find('#')));
+
+                if(line.empty()) { continue; }
+
+                const size_t equals = line.find('=');
+
+                if(equals == string::npos)
+                {
+
+                    error = path + ":" + std::to_string(lineNumber) + ": expected key = value";
+                    return false;
+
+                }
+
+                if(!apply(config, trim(line.substr(0, equals)), trim(line.substr(equals + 1)), error))
+                {
+
+                    error = path + ":" + std::to_string(lineNumber) + ": " + error;
+                    return false;
+
+                }
+            }
+
+            return true;
+
+        }
+
+        // Format(config) returns every setting of config as "key = value" lines, headed by its version.
+        static string format(const ServerConfig& config)
+        {
+
+            string text = "# version " + std::to_string(config.version) + "\n";
+
+            for(const NumericKey& numeric : numericKeys())
+            {
+
+                text += string(numeric.name) + " = " + std::to_string(numeric.get(config)) + "\n";
+
+            }
+
+            text += string("log_level = ") + LOG_LEVEL_NAMES[config.logLevel] + "\n";
+            return text;
+
+        }
+
+        // Current() returns the settings in force. The reference stays valid for the life of the store.
+        inline const ServerConfig& current() const noexcept
+        {
+
+            return *m_current.load(std::memory_order_acquire);
+
+        }
+
+        // SetPath(path) sets the file reload() reads.
+        void setPath(const string& path)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            m_path = path;
+
+        }
+
+        // OnChange(function) calls function with every version published from now on.
+        void onChange(const ChangeFunction& function)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            m_onChange = function;
+
+        }
+
+        // Set(key, value, error) publishes the current settings with key set to value. It returns false, and describes the
+        // problem in error, if the change is not valid; nothing is published then.
+        bool set(const string& key, const string& value, string& error)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+            ServerConfig next = current();
+
+            if(!apply(next, key, value, error)) { return false; }
+
+            if(next.fanoutThreads != current().fanoutThreads)
+            {
+
+                error = "fanout_threads only takes effect at startup";
+                return false;
+
+            }
+
+            publishLocked(next);
+            return true;
+
+        }
+
+        // Reload(error) publishes the current settings overridden by those in the file set with setPath(..); settings the
+        // file leaves out keep their value, and fanout_threads keeps its value whatever the file says. It returns false,
+        // and describes the problem in error, if the file cannot be applied; nothing is published then.
+        bool reload(string& error)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(m_path.empty())
+            {
+
+                error = "no configuration file was given";
+                return false;
+
+            }
+
+            ServerConfig next = current();
+
+            if(!parseFile(m_path, next, error)) { return false; }
+
+            next.fanoutThreads = current().fanoutThreads;
+            publishLocked(next);
+            return true;
+
+        }
+};
@@ -1,28 +1,288 @@
 #include <iostream>
 #include "Server.cpp"
+#include "AdminSocket.cpp"
 #include <stdlib.h>
+#include <csignal>
 
 using std::cout;
 using std::cerr;
 using std::endl;
 
+volatile std::sig_atomic_t g_stopRequested = 0; // Set by SIGINT / SIGTERM so the server can shut down cleanly.
+volatile std::sig_atomic_t g_reloadRequested = 0; // Set by SIGHUP so the server applies its configuration file again.
+
+void handleStopSignal(int /* signal */)
+{
+
+    g_stopRequested = 1;
+
+}
+
+void handleReloadSignal(int /* signal */)
+{
+
+    g_reloadRequested = 1;
+
+}
+
+// ParseCpuArgument(text, cpus) parses the CPU list, text, into cpus. It returns false if text is not a CPU list or names a
+// CPU that is not online.
+bool parseCpuArgument(const string& text, CpuSet& cpus)
+{
+
+    if(!CpuTopology::parseCpuList(text, cpus))
+    {
+
+        cerr << "Invalid CPU list: " << text << endl;
+        return false;
+
+    }
+
+    for(uint32_t cpu : cpus)
+    {
+
+        if(!CpuTopology::getInstance().isOnline(cpu))
+        {
+
+            cerr << "CPU " << cpu << " is not online." << endl;
+            return false;
+
+        }
+    }
+
+    return true;
+
+}
+
 int main(int argc, char* argv[])
 {
 
-    if(argc != 3)
+    if(argc < 3)
     {
 
-        cerr << "Usage: <host> <port>" <<endl;
+        cerr << "Usage: <host> <port> [local socket path] [--capture <trace file>] [--capture-content] [--latency <sample every>] [--latency-export <json file>] [--mailbox <directory>]"
+             << " [--max-connections <n>] [--max-outbound-mb <n>] [--max-loop-lag-ms <n>] [--max-accept-queue <n>] [--config <file>] [--admin <socket path>]"
+             << " [--accept-cpus <cpu list>] [--fanout-cpus <cpu list>] [--reader-cpus <cpu list>]" <<endl;
         return 1;
         
     }
 
+    // Parse the optional arguments that follow the host and port.
+    string localSocketPath;
+    string capturePath;
+    bool captureContent = false;
+    uint latencySampleEvery = 0;
+    string latencyExportPath;
+    string mailboxPath;
+    std::vector<std::pair<string, string>> settings;
+    string configPath;
+    string adminPath;
+    ThreadPlacement placement;
+
+    for(int index = 3; index < argc; index++)
+    {
+
+        const string arg{argv[index]};
+
+        if(arg == "--capture" && index + 1 < argc)
+        {
+
+            capturePath = argv[++index];
+
+        }
+        else if(arg == "--capture-content")
+        {
+
+            captureContent = true;
+
+        }
+        else if(arg == "--latency" && index + 1 < argc)
+        {
+
+            latencySampleEvery = static_cast<uint>(strtoul(argv[++index], nullptr, 10));
+
+        }
+        else if(arg == "--latency-export" && index + 1 < argc)
+        {
+
+            latencyExportPath = argv[++index];
+
+        }
+        else if(arg == "--mailbox" && index + 1 < argc)
+        {
+
+            mailboxPath = argv[++index];
+
+        }
+        else if(arg == "--max-connections" && index + 1 < argc)
+        {
+
+            settings.push_back(std::make_pair("max_connections", argv[++index]));
+
+        }
+        else if(arg == "--max-outbound-mb" && index + 1 < argc)
+        {
+
+            settings.push_back(std::make_pair("max_outbound_bytes", std::to_string(strtoull(argv[++index], nullptr, 10) << 20)));
+
+        }
+        else if(arg == "--max-loop-lag-ms" && index + 1 < argc)
+        {
+
+            settings.push_back(std::make_pair("max_loop_lag_ms", argv[++index]));
+
+        }
+        else if(arg == "--max-accept-queue" && index + 1 < argc)
+        {
+
+            settings.push_back(std::make_pair("max_accept_queue", argv[++index]));
+
+        }
+        else if(arg == "--config" && index + 1 < argc)
+        {
+
+            configPath = argv[++index];
+
+        }
+        else if(arg == "--admin" && index + 1 < argc)
+        {
+
+            adminPath = argv[++index];
+
+        }
+        else if(arg == "--accept-cpus" && index + 1 < argc)
+        {
+
+            if(!parseCpuArgument(argv[++index], placement.acceptCpus)) { return 1; }
+
+        }
+        else if(arg == "--fanout-cpus" && index + 1 < argc)
+        {
+
+            if(!parseCpuArgument(argv[++index], placement.fanoutCpus)) { return 1; }
+
+        }
+        else if(arg == "--reader-cpus" && index + 1 < argc)
+        {
+
+            if(!parseCpuArgument(argv[++index], placement.readerCpus)) { return 1; }
+
+        }
+        else if(localSocketPath.empty() && arg.substr(0, 2) != "--")
+        {
+
+            localSocketPath = arg;
+
+        }
+        else
+        {
+
+            cerr << "Unknown argument: " << arg << endl;
+            return 1;
+
+        }
+    }
+
+    // Settings given on the command line override those in the configuration file.
+    ServerConfig config;
+    string configError;
+
+    if(!configPath.empty() && !ServerConfigStore::parseFile(configPath, config, configError))
+    {
+
+        cerr << "Invalid configuration: " << configError << endl;
+        return 1;
+
+    }
+
+    for(const std::pair<string, string>& setting : settings)
+    {
+
+        if(!ServerConfigStore::apply(config, setting.first, setting.second, configError))
+        {
+
+            cerr << "Invalid argument: " << configError << endl;
+            return 1;
+
+        }
+    }
+
+    // Unless told otherwise, run one fanout shard per fanout CPU.
+    if(config.fanoutThreads == 0 && !placement.fanoutCpus.empty()) { config.fanoutThreads = placement.fanoutCpus.size(); }
+
     char* port_ptr;
     cout << argv[0] << endl;
-    Server server{argv[1], static_cast<unsigned int>(strtol(argv[2], &port_ptr, 10))};
+    Server server{argv[1], static_cast<unsigned int>(strtol(argv[2], &port_ptr, 10)), localSocketPath, config};
+    server.getConfig().setPath(configPath);
+    server.setThreadPlacement(placement);
+    AdminSocket admin;
+
+    if(!adminPath.empty() && !admin.open(adminPath, server.getConfig()))
+    {
+
+        cerr << "Unable to create admin socket: " << adminPath << endl;
+        return 1;
+
+    }
+
+    if(!capturePath.empty() && !server.startCapture(capturePath, captureContent))
+    {
+
+        cerr << "Unable to create trace file: " << capturePath << endl;
+        return 1;
+
+    }
+
+    if(!mailboxPath.empty() && !server.openMailbox(mailboxPath))
+    {
+
+        cerr << "Unable to open mailbox: " << mailboxPath << endl;
+        return 1;
+
+    }
+
+    if(latencySampleEvery > 0) { server.startTracing(latencySampleEvery); }
+
+
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+    std::signal(SIGHUP, handleReloadSignal);
     server.connect();
 
-    while(server.isConnected());
+    // Sleep rather than spin while waiting, so the main thread does not compete with the reactor and fanout threads (and
+    // add to the latencies being traced).
+    while(server.isConnected() && !g_stopRequested)
+    {
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+
+        if(g_reloadRequested)
+        {
+
+            g_reloadRequested = 0;
+
+            if(!server.getConfig().reload(configError)) { cerr << "Unable to reload configuration: " << configError << endl; }
+
+        }
+    }
+
+    admin.close();
+    server.disconnect();
+
+    if(server.getNumRejectedConnections() > 0) { cout << "Rejected " << server.getNumRejectedConnections() << " connections while overloaded." << endl; }
+
+    if(latencySampleEvery > 0)
+    {
+
+        cout << "Latency by stage:" << endl << server.getLatencyTracer().formatSummary();
+
+        if(!latencyExportPath.empty() && !server.getLatencyTracer().exportChromeTrace(latencyExportPath))
+        {
+
+            cerr << "Unable to create latency trace file: " << latencyExportPath << endl;
+
+        }
+    }
     
     return 0;
 
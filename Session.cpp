@@ -0,0 +1,396 @@
+#pragma once
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <sys/socket.h>
+
+using std::string;
+
+// Session is the transport-independent view of a single connection. The Server and Client only ever talk to a
+// Session, so a TCP socket, a Unix domain socket and a shared-memory ring pair can all carry the same packets.
+class Session
+{
+
+    public:
+
+        typedef boost::function<void(const boost::system::error_code& error, size_t numBytes)> IoHandler;
+
+        // Default destructor.
+        virtual ~Session() {}
+
+        // ReadSome(buf, error) synchronously reads at least one byte into buf and returns the number of bytes read.
+        // If an error occurs, it will be stored in error and 0 is returned.
+        virtual size_t readSome(const boost::asio::mutable_buffer& buf, boost::system::error_code& error) = 0;
+
+        // WaitReadable(error) blocks until readSome(..) would not block. This lets a caller hold no receive buffer while idle.
+        virtual void waitReadable(boost::system::error_code& error) = 0;
+
+        // Write(buf, error) synchronously writes the entirety of buf to the peer. If an error occurs, it will be stored in error.
+        virtual void write(const boost::asio::const_buffer& buf, boost::system::error_code& error) = 0;
+
+        // TryWrite(buf, error) writes as much of buf as the transport takes without blocking and returns the number of
+        // bytes written. If nothing could be written, error is set to boost::asio::error::would_block. By default this
+        // falls back to write(..).
+        virtual size_t tryWrite(const boost::asio::const_buffer& buf, boost::system::error_code& error)
+        {
+
+            write(buf, error);
+            return error ? 0 : boost::asio::buffer_size(buf);
+
+        }
+
+        // Close() releases the underlying transport. Only the owner of this Session object may call it, once no other thread
+        // can be using the transport; its descriptor may be reused as soon as it returns.
+        virtual void close() = 0;
+
+        // Shutdown() stops the underlying transport in both directions without releasing it, so any thread blocked inside of
+        // readSome(..), waitReadable(..) or write(..) is woken up and fails. Unlike close(), it may be called from any thread.
+        virtual void shutdown() = 0;
+
+        // IsOpen() returns true if the underlying transport has not been closed.
+        virtual bool isOpen() const = 0;
+
+        // GetHost() returns a printable address of this Session object.
+        virtual string getHost() const = 0;
+
+        // GetTransportName() returns a short name describing the transport of this Session object (ie: "tcp").
+        virtual string getTransportName() const = 0;
+
+        // GetMemoryUsage() returns the number of bytes of memory held by this Session object.
+        virtual size_t getMemoryUsage() const = 0;
+
+        // EnableArrivalTimestamps() asks the transport to note when the kernel received the bytes of each read. Transports
+        // that cannot tell ignore this.
+        virtual void enableArrivalTimestamps() {}
+
+        // GetLastArrivalTime() returns when the kernel received the bytes returned by the most recent readSome(..), in
+        // nanoseconds on the steady clock, or 0 if that is not known (@see enableArrivalTimestamps()).
+        virtual int64_t getLastArrivalTime() const
+        {
+
+            return 0;
+
+        }
+
+        // GetIncomingCpu() returns the CPU the kernel processed the most recently received packets of this Session object on,
+        // or -1 if that is not known.
+        virtual int getIncomingCpu()
+        {
+
+            return -1;
+
+        }
+
+        // SupportsAsync() returns true if asyncReadSome(..) and asyncWrite(..) are available on this Session object.
+        virtual bool supportsAsync() const
+        {
+
+            return false;
+
+        }
+
+        // AsyncReadSome(buf, handler) starts reading at least one byte into buf on the io_service of this Session object,
+        // and calls handler once done. Only available if supportsAsync() returns true.
+        virtual void asyncReadSome(const boost::asio::mutable_buffer& /* buf */, const IoHandler& handler)
+        {
+
+            handler(boost::asio::error::operation_not_supported, 0);
+
+        }
+
+        // AsyncWrite(buf, handler) starts writing the entirety of buf on the io_service of this Session object, and calls
+        // handler once done. buf must stay valid until then. Only available if supportsAsync() returns true.
+        virtual void asyncWrite(const boost::asio::const_buffer& /* buf */, const IoHandler& handler)
+        {
+
+            handler(boost::asio::error::operation_not_supported, 0);
+
+        }
+
+        // ReadUntil(buf, delim) synchronously reads into buf until it contains delim. This mirrors boost::asio::read_until(..),
+        // including throwing a boost::system::system_error if the read fails.
+        size_t readUntil(boost::asio::streambuf& buf, const char delim)
+        {
+
+            size_t searched = 0;
+
+            for(;;)
+            {
+
+                const char* begin = boost::asio::buffer_cast<const char*>(buf.data());
+
+                for(size_t index = searched; index < buf.size(); index++)
+                {
+
+                    if(begin[index] == delim) { return index + 1; }
+
+                }
+
+                searched = buf.size();
+
+                boost::system::error_code error;
+                size_t numBytes = readSome(buf.prepare(512), error);
+
+                if(error) { throw boost::system::system_error{error}; }
+
+                buf.commit(numBytes);
+
+            }
+        }
+};
+
+// StreamSession<Protocol> is a Session that is backed by a connected stream socket of Protocol (ie: tcp or local::stream_protocol).
+template <typename Protocol>
+class StreamSession : public Session
+{
+
+    private:
+
+        typename Protocol::socket m_socket; // The stream socket this StreamSession object wraps.
+        bool m_arrivalTimestamps; // True if readSome(..) asks the kernel for receive timestamps.
+        int64_t m_lastArrival; // @see getLastArrivalTime().
+
+        // ReadSomeTimestamped(buf, error) is readSome(..), but also takes the kernel receive timestamp of the bytes read.
+        size_t readSomeTimestamped(const boost::asio::mutable_buffer& buf, boost::system::error_code& error)
+        {
+
+            error = boost::system::error_code{};
+
+            struct iovec iov{boost::asio::buffer_cast<void*>(buf), boost::asio::buffer_size(buf)};
+            char control[CMSG_SPACE(sizeof(struct timespec))];
+            struct msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            ssize_t numBytes;
+
+            while((numBytes = ::recvmsg(m_socket.native_handle(), &message, 0)) < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+
+                if(errno != EINTR) { m_socket.wait(Protocol::socket::wait_read, error); }
+
+                if(error) { return 0; }
+
+            }
+
+            if(numBytes < 0)
+            {
+
+                error = boost::system::error_code{errno, boost::system::system_category()};
+                return 0;
+
+            }
+
+            if(numBytes == 0)
+            {
+
+                error = boost::asio::error::eof;
+                return 0;
+
+            }
+
+            m_lastArrival = 0;
+
+            for(struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+            {
+
+                if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_TIMESTAMPNS) { continue; }
+
+                // The kernel stamps on the realtime clock; move it onto the steady clock by the current offset between them.
+                struct timespec stamp;
+                memcpy(&stamp, CMSG_DATA(header), sizeof(stamp));
+                const int64_t realtime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                const int64_t steady = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                m_lastArrival = steady - (realtime - (stamp.tv_sec * 1000000000LL + stamp.tv_nsec));
+
+            }
+
+            return numBytes;
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        StreamSession(const StreamSession& rhs) = delete;
+        StreamSession& operator=(const StreamSession& rhs) = delete;
+
+        // One-parameter constructor that creates an unconnected socket on the io_service, ios.
+        explicit StreamSession(boost::asio::io_service& ios) : m_socket{ios}, m_arrivalTimestamps{false}, m_lastArrival{0} {}
+
+        // GetSocket() returns the stream socket that this StreamSession object wraps.
+        inline typename Protocol::socket& getSocket() noexcept
+        {
+
+            return m_socket;
+
+        }
+
+        size_t readSome(const boost::asio::mutable_buffer& buf, boost::system::error_code& error) override
+        {
+
+            if(m_arrivalTimestamps) { return readSomeTimestamped(buf, error); }
+
+            return m_socket.read_some(boost::asio::buffer(buf), error);
+
+        }
+
+        void waitReadable(boost::system::error_code& error) override
+        {
+
+            m_socket.wait(Protocol::socket::wait_read, error);
+
+        }
+
+        void write(const boost::asio::const_buffer& buf, boost::system::error_code& error) override
+        {
+
+            boost::asio::write(m_socket, boost::asio::buffer(buf), error);
+
+        }
+
+        size_t tryWrite(const boost::asio::const_buffer& buf, boost::system::error_code& error) override
+        {
+
+            error = boost::system::error_code{};
+            const ssize_t numBytes = ::send(m_socket.native_handle(), boost::asio::buffer_cast<const void*>(buf), boost::asio::buffer_size(buf), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+            if(numBytes >= 0) { return numBytes; }
+
+            if(errno == EAGAIN || errno == EWOULDBLOCK) { error = boost::asio::error::would_block; }
+            else { error = boost::system::error_code{errno, boost::system::system_category()}; }
+
+            return 0;
+
+        }
+
+        void close() override
+        {
+
+            boost::system::error_code ignored;
+            m_socket.shutdown(Protocol::socket::shutdown_both, ignored);
+            m_socket.close(ignored);
+
+        }
+
+        void shutdown() override
+        {
+
+            boost::system::error_code ignored;
+            m_socket.shutdown(Protocol::socket::shutdown_both, ignored);
+
+        }
+
+        bool isOpen() const override
+        {
+
+            return m_socket.is_open();
+
+        }
+
+        string getHost() const override
+        {
+
+            return endpointToString(m_socket);
+
+        }
+
+        string getTransportName() const override
+        {
+
+            return transportName(m_socket);
+
+        }
+
+        size_t getMemoryUsage() const override
+        {
+
+            return sizeof(*this);
+
+        }
+
+        void enableArrivalTimestamps() override
+        {
+
+            const int enable = 1;
+            m_arrivalTimestamps = ::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+
+        }
+
+        int64_t getLastArrivalTime() const override
+        {
+
+            return m_lastArrival;
+
+        }
+
+        int getIncomingCpu() override
+        {
+
+#ifdef SO_INCOMING_CPU
+            int cpu = -1;
+            socklen_t length = sizeof(cpu);
+
+            if(::getsockopt(m_socket.native_handle(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length) == 0) { return cpu; }
+#endif
+
+            return -1;
+
+        }
+
+        bool supportsAsync() const override
+        {
+
+            return true;
+
+        }
+
+        void asyncReadSome(const boost::asio::mutable_buffer& buf, const IoHandler& handler) override
+        {
+
+            m_socket.async_read_some(boost::asio::buffer(buf), handler);
+
+        }
+
+        void asyncWrite(const boost::asio::const_buffer& buf, const IoHandler& handler) override
+        {
+
+            boost::asio::async_write(m_socket, boost::asio::buffer(buf), handler);
+
+        }
+
+    private:
+
+        // TransportName(socket) returns the transport name of a TCP socket.
+        static string transportName(const boost::asio::ip::tcp::socket& /* socket */) { return "tcp"; }
+
+        // TransportName(socket) returns the transport name of a Unix domain socket.
+        static string transportName(const boost::asio::local::stream_protocol::socket& /* socket */) { return "unix"; }
+
+        // EndpointToString(socket) returns the printable local address of a TCP socket.
+        static string endpointToString(const boost::asio::ip::tcp::socket& socket)
+        {
+
+            boost::system::error_code error;
+            const auto& endpoint = socket.local_endpoint(error);
+            return error ? string{} : endpoint.address().to_string();
+
+        }
+
+        // EndpointToString(socket) returns the path of a Unix domain socket.
+        static string endpointToString(const boost::asio::local::stream_protocol::socket& socket)
+        {
+
+            boost::system::error_code error;
+            const auto& endpoint = socket.local_endpoint(error);
+            return error ? string{"local"} : endpoint.path();
+
+        }
+};
+
+typedef StreamSession<boost::asio::ip::tcp> TcpSession;
+typedef StreamSession<boost::asio::local::stream_protocol> LocalSession;
@@ -0,0 +1,421 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+
+using std::string;
+
+// ShmRingHeader is the control block placed at the front of each ring inside of the shared-memory segment. The producer
+// and consumer indices live on separate cache lines so the two processes do not false-share.
+struct ShmRingHeader
+{
+
+    alignas(64) std::atomic<uint64_t> head; // Total number of bytes ever written by the producer.
+    alignas(64) std::atomic<uint64_t> tail; // Total number of bytes ever consumed by the consumer.
+    alignas(64) std::atomic<uint32_t> dataSeq; // Futex word bumped by the producer after every push.
+    std::atomic<uint32_t> spaceSeq; // Futex word bumped by the consumer after every pop.
+    std::atomic<uint32_t> closed; // Set to 1 once either side has closed the ring.
+    uint32_t capacity; // The size of the data region in bytes. Always a power of two. Only read when a ring is attached.
+
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ShmRing requires lock-free 64-bit atomics in shared memory.");
+
+// ShmRing is a single-producer, single-consumer ring of length-prefixed frames that lives in memory shared between
+// two processes. Waiting is done with (non-private) futexes on the sequence words in the header, so an idle ring costs no CPU.
+//
+// The peer process can write anything to the header at any time, so nothing read from it is trusted: the capacity is
+// copied out once when the ring is attached, and a ring whose indices or frame lengths do not fit that capacity is closed.
+class ShmRing
+{
+
+    private:
+
+        ShmRingHeader* m_header; // The control block of this ring.
+        char* m_data; // The data region of this ring; m_capacity bytes long.
+        uint32_t m_capacity; // The size of the data region, as validated when this ring was attached.
+
+        // FutexWait(word, expected, timeoutMs) blocks while *word == expected, for at most timeoutMs milliseconds.
+        static void futexWait(std::atomic<uint32_t>& word, uint32_t expected, long timeoutMs)
+        {
+
+            struct timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+
+        }
+
+        // FutexWake(word) wakes every process blocked on word.
+        static void futexWake(std::atomic<uint32_t>& word)
+        {
+
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+
+        }
+
+        // CopyIn(position, src, len) copies len bytes of src into the data region at position, wrapping if needed.
+        void copyIn(uint64_t position, const char* src, size_t len)
+        {
+
+            const size_t offset = position & (m_capacity - 1);
+            const size_t first = std::min(len, static_cast<size_t>(m_capacity) - offset);
+            memcpy(m_data + offset, src, first);
+            memcpy(m_data, src + first, len - first);
+
+        }
+
+        // CopyOut(position, dst, len) copies len bytes at position of the data region into dst, wrapping if needed.
+        void copyOut(uint64_t position, char* dst, size_t len) const
+        {
+
+            const size_t offset = position & (m_capacity - 1);
+            const size_t first = std::min(len, static_cast<size_t>(m_capacity) - offset);
+            memcpy(dst, m_data + offset, first);
+            memcpy(dst + first, m_data, len - first);
+
+        }
+
+    public:
+
+        // Default constructor; the ring must be attached with attach(..) before use.
+        ShmRing() noexcept : m_header{nullptr}, m_data{nullptr}, m_capacity{0} {}
+
+        // Attach(base, initialize, capacity) binds this ring, with a data region of capacity bytes, to the memory at base.
+        // If initialize is set, the header is reset as well.
+        void attach(char* base, bool initialize, uint32_t capacity)
+        {
+
+            m_header = reinterpret_cast<ShmRingHeader*>(base);
+            m_data = base + sizeof(ShmRingHeader);
+            m_capacity = capacity;
+
+            if(initialize)
+            {
+
+                new (m_header) ShmRingHeader{};
+                m_header->capacity = capacity;
+
+            }
+        }
+
+        // BytesRequired(capacity) returns the number of bytes of shared memory a ring of capacity occupies.
+        static size_t bytesRequired(uint32_t capacity) noexcept
+        {
+
+            return sizeof(ShmRingHeader) + capacity;
+
+        }
+
+        // TryPush(frame, len) appends one frame to the ring. It returns false if there is not enough free space.
+        bool tryPush(const char* frame, uint32_t len)
+        {
+
+            const uint64_t head = m_header->head.load(std::memory_order_relaxed);
+            const uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+
+            if(head - tail > m_capacity)
+            {
+
+                close();
+                return false;
+
+            }
+
+            if(m_capacity - (head - tail) < len + sizeof(uint32_t)) { return false; }
+
+            copyIn(head, reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+            copyIn(head + sizeof(uint32_t), frame, len);
+            m_header->head.store(head + sizeof(uint32_t) + len, std::memory_order_release);
+            m_header->dataSeq.fetch_add(1, std::memory_order_release);
+            futexWake(m_header->dataSeq);
+            return true;
+
+        }
+
+        // TryPop(frame) removes the oldest frame from the ring into frame. It returns false if the ring is empty.
+        bool tryPop(string& frame)
+        {
+
+            const uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+            const uint64_t head = m_header->head.load(std::memory_order_acquire);
+
+            if(head == tail) { return false; }
+
+            // The peer is another process; never trust indices or a length that run past the ring or what it has published.
+            if(head - tail > m_capacity || head - tail < sizeof(uint32_t))
+            {
+
+                close();
+                return false;
+
+            }
+
+            uint32_t len;
+            copyOut(tail, reinterpret_cast<char*>(&len), sizeof(uint32_t));
+
+            if(len > m_capacity - sizeof(uint32_t) || len > head - tail - sizeof(uint32_t))
+            {
+
+                close();
+                return false;
+
+            }
+
+            frame.resize(len);
+            copyOut(tail + sizeof(uint32_t), &frame[0], len);
+            m_header->tail.store(tail + sizeof(uint32_t) + len, std::memory_order_release);
+            m_header->spaceSeq.fetch_add(1, std::memory_order_release);
+            futexWake(m_header->spaceSeq);
+            return true;
+
+        }
+
+        // WaitForData(timeoutMs) blocks until the ring may contain a frame, it is closed, or timeoutMs has passed.
+        void waitForData(long timeoutMs)
+        {
+
+            const uint32_t seq = m_header->dataSeq.load(std::memory_order_acquire);
+
+            if(m_header->head.load(std::memory_order_acquire) != m_header->tail.load(std::memory_order_relaxed) || isClosed()) { return; }
+
+            futexWait(m_header->dataSeq, seq, timeoutMs);
+
+        }
+
+        // WaitForSpace(len, timeoutMs) blocks until a frame of len bytes may fit, the ring is closed, or timeoutMs has passed.
+        void waitForSpace(uint32_t len, long timeoutMs)
+        {
+
+            const uint32_t seq = m_header->spaceSeq.load(std::memory_order_acquire);
+            const uint64_t used = m_header->head.load(std::memory_order_relaxed) - m_header->tail.load(std::memory_order_acquire);
+
+            if(used > m_capacity || m_capacity - used >= len + sizeof(uint32_t) || isClosed()) { return; }
+
+            futexWait(m_header->spaceSeq, seq, timeoutMs);
+
+        }
+
+        // IsEmpty() returns true if the ring holds no frames.
+        inline bool isEmpty() const noexcept
+        {
+
+            return m_header->head.load(std::memory_order_acquire) == m_header->tail.load(std::memory_order_acquire);
+
+        }
+
+        // GetCapacity() returns the size of the data region of this ring in bytes.
+        inline uint32_t getCapacity() const noexcept
+        {
+
+            return m_capacity;
+
+        }
+
+        // Close() marks this ring as closed and wakes up both sides.
+        void close()
+        {
+
+            m_header->closed.store(1, std::memory_order_release);
+            m_header->dataSeq.fetch_add(1, std::memory_order_release);
+            m_header->spaceSeq.fetch_add(1, std::memory_order_release);
+            futexWake(m_header->dataSeq);
+            futexWake(m_header->spaceSeq);
+
+        }
+
+        // IsClosed() returns true if either side has closed this ring.
+        inline bool isClosed() const noexcept
+        {
+
+            return m_header->closed.load(std::memory_order_acquire) != 0;
+
+        }
+};
+
+// ShmRingPair is a named POSIX shared-memory segment that holds two ShmRing objects: one for frames travelling
+// from the client to the server and one for frames travelling from the server to the client.
+class ShmRingPair
+{
+
+    public:
+
+        inline static const string NAME_PREFIX = "/tcpchat-"; // Every segment name starts with this; the server opens no other.
+
+    private:
+
+        char* m_base; // The start of the mapped segment.
+        size_t m_length; // The length of the mapped segment in bytes.
+        ShmRing m_rings[2]; // Index 0 carries client -> server frames, index 1 carries server -> client frames.
+        bool m_isServer; // True if this ShmRingPair object was opened by the server side.
+
+        // Map(fd, length) maps length bytes of fd into this process.
+        void map(int fd, size_t length)
+        {
+
+            void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+
+            if(addr == MAP_FAILED) { throw std::runtime_error{"ShmRingPair: mmap failed"}; }
+
+            m_base = static_cast<char*>(addr);
+            m_length = length;
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        ShmRingPair(const ShmRingPair& rhs) = delete;
+        ShmRingPair& operator=(const ShmRingPair& rhs) = delete;
+
+        // Default constructor.
+        ShmRingPair() noexcept : m_base{nullptr}, m_length{0}, m_isServer{false} {}
+
+        // Destructor that unmaps the segment.
+        ~ShmRingPair()
+        {
+
+            if(m_base != nullptr)
+            {
+
+                munmap(m_base, m_length);
+
+            }
+        }
+
+        // Create(name, capacity) creates a new segment called name with two rings of capacity bytes each. This is
+        // done by the client, which then hands name to the server.
+        void create(const string& name, uint32_t capacity)
+        {
+
+            if(capacity == 0 || (capacity & (capacity - 1)) != 0) { throw std::invalid_argument{"ShmRingPair: capacity must be a power of two"}; }
+
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+            if(fd < 0) { throw std::runtime_error{"ShmRingPair: unable to create " + name}; }
+
+            const size_t ringBytes = ShmRing::bytesRequired(capacity);
+
+            if(ftruncate(fd, ringBytes * 2) != 0)
+            {
+
+                ::close(fd);
+                shm_unlink(name.c_str());
+                throw std::runtime_error{"ShmRingPair: unable to size " + name};
+
+            }
+
+            map(fd, ringBytes * 2);
+            m_rings[0].attach(m_base, true, capacity);
+            m_rings[1].attach(m_base + ringBytes, true, capacity);
+            m_isServer = false;
+
+        }
+
+        // Open(name, ownerUid) attaches to a segment previously created by a client running as ownerUid and unlinks its
+        // name, so the segment is reclaimed by the kernel as soon as both processes unmap it. Segments not named with
+        // NAME_PREFIX, or owned by anyone else, are left alone.
+        void open(const string& name, uid_t ownerUid)
+        {
+
+            if(name.compare(0, NAME_PREFIX.length(), NAME_PREFIX) != 0 || name.find('/', 1) != string::npos)
+            {
+
+                throw std::runtime_error{"ShmRingPair: " + name + " is not a ring pair name"};
+
+            }
+
+            int fd = shm_open(name.c_str(), O_RDWR, 0600);
+
+            if(fd < 0) { throw std::runtime_error{"ShmRingPair: unable to open " + name}; }
+
+            struct stat st;
+
+            if(fstat(fd, &st) != 0 || st.st_uid != ownerUid)
+            {
+
+                ::close(fd);
+                throw std::runtime_error{"ShmRingPair: " + name + " is not owned by the client"};
+
+            }
+
+            shm_unlink(name.c_str());
+
+            if(st.st_size < static_cast<off_t>(2 * sizeof(ShmRingHeader)))
+            {
+
+                ::close(fd);
+                throw std::runtime_error{"ShmRingPair: " + name + " is not a ring pair"};
+
+            }
+
+            map(fd, st.st_size);
+
+            // Read the capacity once; the rings keep this copy, whatever the client writes to the header later.
+            const uint32_t capacity = reinterpret_cast<volatile ShmRingHeader*>(m_base)->capacity;
+
+            if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+            {
+
+                throw std::runtime_error{"ShmRingPair: " + name + " has an invalid capacity"};
+
+            }
+
+            const size_t ringBytes = ShmRing::bytesRequired(capacity);
+
+            if(ringBytes * 2 != m_length)
+            {
+
+                throw std::runtime_error{"ShmRingPair: " + name + " has an unexpected size"};
+
+            }
+
+            m_rings[0].attach(m_base, false, capacity);
+            m_rings[1].attach(m_base + ringBytes, false, capacity);
+            m_isServer = true;
+
+        }
+
+        // GetMappedBytes() returns the size of the mapped segment.
+        inline size_t getMappedBytes() const noexcept
+        {
+
+            return m_length;
+
+        }
+
+        // GetInbound() returns the ring this side consumes from.
+        inline ShmRing& getInbound() noexcept
+        {
+
+            return m_rings[m_isServer ? 0 : 1];
+
+        }
+
+        // GetOutbound() returns the ring this side produces into.
+        inline ShmRing& getOutbound() noexcept
+        {
+
+            return m_rings[m_isServer ? 1 : 0];
+
+        }
+
+        // Close() closes both rings.
+        void close()
+        {
+
+            if(m_base == nullptr) { return; }
+
+            m_rings[0].close();
+            m_rings[1].close();
+
+        }
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <sys/socket.h>
+
+// USER DEFINED IMPORTS
+#include "Session.cpp"
+#include "ShmRing.cpp"
+
+using std::string;
+
+// ShmSession is a Session whose packets travel through a ShmRingPair instead of the kernel socket layer. The Unix domain
+// socket that negotiated the rings is kept open as a control channel; when the peer process exits, the kernel closes it,
+// which is how a ShmSession notices that its peer is gone.
+class ShmSession : public Session
+{
+
+    private:
+
+        inline static const long WAIT_SLICE_MS = 100; // The longest a blocked reader / writer sleeps before re-checking the control channel.
+
+        boost::scoped_ptr<ShmRingPair> m_rings; // The ring pair that carries the packets of this ShmSession object.
+        boost::shared_ptr<LocalSession> m_control; // The Unix domain socket that negotiated m_rings.
+        string m_pending; // The most recently popped frame that has not been fully handed to readSome(..) yet.
+        size_t m_pendingOffset; // The number of bytes of m_pending that have already been returned.
+        std::atomic<bool> m_open; // The open status of this ShmSession object.
+
+        // PeerIsAlive() returns false if the control channel has been closed by the peer.
+        bool peerIsAlive()
+        {
+
+            char probe;
+            ssize_t result = ::recv(m_control->getSocket().native_handle(), &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+            return result != 0 && !(result < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        ShmSession(const ShmSession& rhs) = delete;
+        ShmSession& operator=(const ShmSession& rhs) = delete;
+
+        // Two-parameter constructor that takes ownership of an attached ring pair and the control channel that negotiated it.
+        ShmSession(ShmRingPair* rings, const boost::shared_ptr<LocalSession>& control) : m_rings{rings}, m_control{control}, m_pendingOffset{0}, m_open{true} {}
+
+        // Destructor that closes the rings and control channel.
+        ~ShmSession()
+        {
+
+            close();
+
+        }
+
+        size_t readSome(const boost::asio::mutable_buffer& buf, boost::system::error_code& error) override
+        {
+
+            error = boost::system::error_code{};
+
+            while(m_pendingOffset == m_pending.size())
+            {
+
+                m_pendingOffset = 0;
+
+                if(m_rings->getInbound().tryPop(m_pending)) { continue; }
+
+                m_pending.clear();
+
+                if(!m_open || m_rings->getInbound().isClosed() || !peerIsAlive())
+                {
+
+                    error = boost::asio::error::eof;
+                    return 0;
+
+                }
+
+                m_rings->getInbound().waitForData(WAIT_SLICE_MS);
+
+            }
+
+            const size_t numBytes = std::min(boost::asio::buffer_size(buf), m_pending.size() - m_pendingOffset);
+            memcpy(boost::asio::buffer_cast<char*>(buf), m_pending.data() + m_pendingOffset, numBytes);
+            m_pendingOffset += numBytes;
+            return numBytes;
+
+        }
+
+        void waitReadable(boost::system::error_code& error) override
+        {
+
+            error = boost::system::error_code{};
+
+            while(m_pendingOffset == m_pending.size() && m_rings->getInbound().isEmpty())
+            {
+
+                if(!m_open || m_rings->getInbound().isClosed() || !peerIsAlive())
+                {
+
+                    error = boost::asio::error::eof;
+                    return;
+
+                }
+
+                m_rings->getInbound().waitForData(WAIT_SLICE_MS);
+
+            }
+        }
+
+        void write(const boost::asio::const_buffer& buf, boost::system::error_code& error) override
+        {
+
+            error = boost::system::error_code{};
+
+            const char* data = boost::asio::buffer_cast<const char*>(buf);
+            const size_t size = boost::asio::buffer_size(buf);
+            ShmRing& outbound = m_rings->getOutbound();
+
+            if(size + sizeof(uint32_t) > outbound.getCapacity())
+            {
+
+                error = boost::asio::error::message_size;
+                return;
+
+            }
+
+            while(!outbound.tryPush(data, static_cast<uint32_t>(size)))
+            {
+
+                if(!m_open || outbound.isClosed() || !peerIsAlive())
+                {
+
+                    error = boost::asio::error::broken_pipe;
+                    return;
+
+                }
+
+                outbound.waitForSpace(static_cast<uint32_t>(size), WAIT_SLICE_MS);
+
+            }
+        }
+
+        size_t tryWrite(const boost::asio::const_buffer& buf, boost::system::error_code& error) override
+        {
+
+            error = boost::system::error_code{};
+
+            const char* data = boost::asio::buffer_cast<const char*>(buf);
+            const size_t size = boost::asio::buffer_size(buf);
+            ShmRing& outbound = m_rings->getOutbound();
+
+            if(size + sizeof(uint32_t) > outbound.getCapacity())
+            {
+
+                error = boost::asio::error::message_size;
+                return 0;
+
+            }
+
+            // A ring frame is pushed whole or not at all.
+            if(outbound.tryPush(data, static_cast<uint32_t>(size))) { return size; }
+
+            error = !m_open || outbound.isClosed() || !peerIsAlive() ? boost::asio::error::broken_pipe : boost::asio::error::would_block;
+            return 0;
+
+        }
+
+        void close() override
+        {
+
+            if(!m_open.exchange(false)) { return; }
+
+            m_rings->close();
+            m_control->close();
+
+        }
+
+        void shutdown() override
+        {
+
+            // Closing the rings wakes both directions; the control channel is only shut down, since peerIsAlive() may be
+            // reading it on another thread.
+            m_rings->close();
+            m_control->shutdown();
+
+        }
+
+        bool isOpen() const override
+        {
+
+            return m_open;
+
+        }
+
+        string getHost() const override
+        {
+
+            return m_control->getHost();
+
+        }
+
+        string getTransportName() const override
+        {
+
+            return "shm";
+
+        }
+
+        size_t getMemoryUsage() const override
+        {
+
+            return sizeof(*this) + m_pending.capacity() + m_rings->getMappedBytes() + m_control->getMemoryUsage();
+
+        }
+};
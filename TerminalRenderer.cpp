@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using std::string;
+
+// TerminalRenderer decouples receiving lines from displaying them. post(..) only stores a line in a bounded scrollback
+// ring and returns; a render thread writes whatever has arrived since its last frame with a single write, at most once
+// every FRAME_INTERVAL_MS. If more than MAX_LINES_PER_FRAME lines arrived since the last frame, only the newest are
+// written, after a "+N messages" line standing in for the rest, so a burst never slows whoever calls post(..). The
+// collapsed lines stay in the ring, and can be shown later with showHistory(..) until they are overwritten.
+class TerminalRenderer
+{
+
+    public:
+
+        inline static const size_t SCROLLBACK_LINES = 4096; // The number of most recent lines the ring holds.
+        inline static const size_t MAX_LINES_PER_FRAME = 50; // The most lines a frame writes; older ones are collapsed.
+        inline static const uint32_t FRAME_INTERVAL_MS = 33; // The least time between frames, about 30 frames per second.
+
+    private:
+
+        std::vector<string> m_lines; // The scrollback ring. The line numbered n is at m_lines[n % SCROLLBACK_LINES].
+        uint64_t m_nextLine; // The number of the next line posted.
+        uint64_t m_nextRendered; // The number of the first line the next frame writes.
+        bool m_waiting; // True while the render thread waits for a line to be posted.
+        bool m_running; // The running status of the render thread.
+        boost::mutex m_mutex; // Guards the members above.
+        boost::condition_variable m_wakeup; // Signalled when a line is posted while m_waiting is set, or the render thread stops.
+        boost::mutex m_outputMutex; // Serialises writes to the standard output stream.
+        std::atomic<uint64_t> m_numCollapsed; // The number of lines that were collapsed rather than written.
+        boost::thread m_thread; // The render thread.
+
+        // WriteAll(text) writes text to the standard output stream, and returns false if it could not.
+        bool writeAll(const string& text)
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_outputMutex};
+            size_t offset = 0;
+
+            while(offset < text.length())
+            {
+
+                const ssize_t numBytes = ::write(STDOUT_FILENO, text.data() + offset, text.length() - offset);
+
+                if(numBytes < 0 && errno == EINTR) { continue; }
+
+                if(numBytes <= 0) { return false; }
+
+                offset += numBytes;
+
+            }
+
+            return true;
+
+        }
+
+        // RenderFrame(frame) writes every line posted since the last frame, collapsing the oldest of them if there are too
+        // many. Frame is a buffer kept between calls.
+        void renderFrame(string& frame)
+        {
+
+            frame.clear();
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                uint64_t first = m_nextRendered;
+
+                // Lines older than the newest MAX_LINES_PER_FRAME, including any the ring has since overwritten, are collapsed.
+                if(m_nextLine - first > MAX_LINES_PER_FRAME)
+                {
+
+                    const uint64_t numCollapsed = m_nextLine - first - MAX_LINES_PER_FRAME;
+                    first += numCollapsed;
+                    m_numCollapsed += numCollapsed;
+                    frame += "+" + std::to_string(numCollapsed) + " messages (/history " + std::to_string(std::min<uint64_t>(numCollapsed + MAX_LINES_PER_FRAME, SCROLLBACK_LINES)) + " to show them)\n";
+
+                }
+
+                for(uint64_t line = first; line < m_nextLine; line++)
+                {
+
+                    frame += m_lines[line % SCROLLBACK_LINES];
+                    frame += '\n';
+
+                }
+
+                m_nextRendered = m_nextLine;
+
+            }
+
+            if(!frame.empty()) { writeAll(frame); }
+
+        }
+
+        // Run() is the body of the render thread. It sleeps until a line is posted, renders a frame, then waits out the
+        // rest of the frame interval so lines posted meanwhile go out together.
+        void run()
+        {
+
+            string frame;
+
+            for(;;)
+            {
+
+                {
+
+                    boost::unique_lock<boost::mutex> lock{m_mutex};
+                    m_waiting = true;
+
+                    while(m_nextRendered == m_nextLine && m_running) { m_wakeup.wait(lock); }
+
+                    m_waiting = false;
+
+                    if(!m_running) { return; }
+
+                }
+
+                renderFrame(frame);
+                boost::this_thread::sleep(boost::posix_time::milliseconds(FRAME_INTERVAL_MS));
+
+            }
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        TerminalRenderer(const TerminalRenderer& rhs) = delete;
+        TerminalRenderer& operator=(const TerminalRenderer& rhs) = delete;
+
+        // Default constructor. Lines are only written once start() is called.
+        TerminalRenderer() : m_lines(SCROLLBACK_LINES), m_nextLine{0}, m_nextRendered{0}, m_waiting{false}, m_running{false}, m_numCollapsed{0} {}
+
+        // Destructor that stops the render thread.
+        ~TerminalRenderer()
+        {
+
+            stop();
+
+        }
+
+        // Start() starts the render thread.
+        void start()
+        {
+
+            boost::lock_guard<boost::mutex> lock{m_mutex};
+
+            if(m_running) { return; }
+
+            m_running = true;
+            m_thread = boost::thread{boost::bind(&TerminalRenderer::run, this)};
+
+        }
+
+        // Stop() stops the render thread, then writes every line it had not written yet.
+        void stop()
+        {
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                m_running = false;
+
+            }
+
+            m_wakeup.notify_all();
+
+            if(m_thread.joinable() && m_thread.get_id() != boost::this_thread::get_id()) { m_thread.join(); }
+
+            string frame;
+            renderFrame(frame);
+
+        }
+
+        // Post(line) stores line in the scrollback ring for the next frame, and returns at once. It may be called from any
+        // thread.
+        void post(const string& line)
+        {
+
+            bool wakeup;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                m_lines[m_nextLine++ % SCROLLBACK_LINES].assign(line);
+                wakeup = m_waiting;
+
+            }
+
+            if(wakeup) { m_wakeup.notify_one(); }
+
+        }
+
+        // ShowHistory(count) writes the count most recent lines still in the scrollback ring, oldest first.
+        void showHistory(size_t count)
+        {
+
+            string text;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                const uint64_t numAvailable = std::min<uint64_t>(m_nextLine, SCROLLBACK_LINES);
+                count = static_cast<size_t>(std::min<uint64_t>(count, numAvailable));
+                text = "--- The last " + std::to_string(count) + " messages ---\n";
+
+                for(uint64_t line = m_nextLine - count; line < m_nextLine; line++)
+                {
+
+                    text += m_lines[line % SCROLLBACK_LINES];
+                    text += '\n';
+
+                }
+            }
+
+            writeAll(text);
+
+        }
+
+        // GetNumCollapsed() returns the number of lines that were collapsed rather than written.
+        inline uint64_t getNumCollapsed() const noexcept
+        {
+
+            return m_numCollapsed.load();
+
+        }
+};
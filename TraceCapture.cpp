@@ -0,0 +1,301 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using std::string;
+
+// A trace file begins with a TraceFileHeader, followed by a sequence of records. Each record is a TraceRecordHeader,
+// followed by payloadSize bytes of payload if (and only if) the file was captured with TRACE_FLAG_CONTENT.
+//
+// The tag of a record is the middle character of the packet tag (ie: 'm' for "%m%"), or one of the TRACE_EVENT_*
+// values for connection events that have no packet of their own.
+struct TraceFileHeader
+{
+
+    char magic[4]; // Always "TCTR".
+    uint32_t version; // The version of this file layout; currently 1.
+    uint32_t flags; // A combination of TRACE_FLAG_* values.
+    uint32_t reserved; // Always 0.
+    int64_t startTime; // Nanoseconds on the system clock when the capture started.
+
+};
+
+#pragma pack(push, 1)
+struct TraceRecordHeader
+{
+
+    uint64_t timestamp; // Nanoseconds on the monotonic clock since the capture started.
+    uint32_t connectionId; // The id the server assigned to the connection that sent this frame.
+    uint32_t payloadSize; // The number of bytes between the packet tag and the terminator.
+    char tag; // @see TraceFileHeader.
+
+};
+#pragma pack(pop)
+
+static const uint32_t TRACE_VERSION = 1;
+static const uint32_t TRACE_FLAG_CONTENT = 1; // Records carry their payload bytes, not only their size.
+static const char TRACE_EVENT_DISCONNECT = '\0'; // The connection was closed.
+
+// TraceRecord is a record that has been loaded from a trace file.
+struct TraceRecord
+{
+
+    TraceRecordHeader header;
+    string payload; // Empty unless the trace was captured with TRACE_FLAG_CONTENT.
+
+};
+
+// TraceCapture records every inbound frame of a Server to a compact binary trace file. Recording only appends to an
+// in-memory buffer under a short lock; a writer thread takes the buffer whole once it fills, or every FLUSH_INTERVAL_MS,
+// and writes it out in one block, so disk I/O never happens on the thread recording. If the disk falls so far behind that
+// MAX_BUFFERED bytes are waiting, further records are dropped and counted rather than buffered without bound.
+class TraceCapture
+{
+
+    private:
+
+        inline static const size_t FLUSH_THRESHOLD = 256 * 1024; // Wake the writer thread once the buffer holds this many bytes...
+        inline static const long FLUSH_INTERVAL_MS = 1000; // ...or once this long has passed since it last wrote.
+        inline static const size_t MAX_BUFFERED = 64 * FLUSH_THRESHOLD; // Records arriving while this much waits to be written are dropped.
+
+        FILE* m_file; // The trace file, or nullptr while not capturing. Only written to by m_writerThread while capturing.
+        bool m_includeContent; // True if payload bytes are written alongside each record.
+        std::chrono::steady_clock::time_point m_start; // When the capture started.
+        std::atomic<bool> m_active; // Readable without the lock, so an inactive capture costs a single load on the read path.
+        bool m_running; // True while m_writerThread accepts records.
+        std::vector<char> m_buffer; // Records not yet taken by m_writerThread.
+        std::atomic<uint64_t> m_numDropped; // The number of records dropped because m_buffer was full.
+        boost::mutex m_mutex; // Guards m_running and m_buffer.
+        boost::condition_variable m_wakeup; // Signalled once m_buffer reaches FLUSH_THRESHOLD, or the capture stops.
+        boost::thread m_writerThread; // Writes m_buffer to m_file.
+
+        // RunWriter() is the body of m_writerThread. It takes the buffer whenever it fills or the flush interval passes,
+        // and writes it without holding m_mutex.
+        void runWriter()
+        {
+
+            std::vector<char> block;
+
+            for(;;)
+            {
+
+                bool running;
+
+                {
+
+                    boost::unique_lock<boost::mutex> lock{m_mutex};
+
+                    if(m_running && m_buffer.size() < FLUSH_THRESHOLD) { m_wakeup.timed_wait(lock, boost::posix_time::milliseconds(FLUSH_INTERVAL_MS)); }
+
+                    block.swap(m_buffer);
+                    running = m_running;
+
+                }
+
+                if(!block.empty())
+                {
+
+                    fwrite(block.data(), 1, block.size(), m_file);
+                    fflush(m_file);
+                    block.clear();
+
+                }
+
+                if(!running) { return; }
+
+            }
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        TraceCapture(const TraceCapture& rhs) = delete;
+        TraceCapture& operator=(const TraceCapture& rhs) = delete;
+
+        // Default constructor.
+        TraceCapture() noexcept : m_file{nullptr}, m_includeContent{false}, m_active{false}, m_running{false}, m_numDropped{0} {}
+
+        // Destructor that finishes any capture in progress.
+        ~TraceCapture()
+        {
+
+            stop();
+
+        }
+
+        // Start(path, includeContent) begins capturing to a new trace file at path. If includeContent is set, each record
+        // also carries its payload; otherwise only its size is kept. It returns false if the file could not be created.
+        bool start(const string& path, bool includeContent)
+        {
+
+            stop();
+            m_file = fopen(path.c_str(), "wb");
+
+            if(m_file == nullptr) { return false; }
+
+            TraceFileHeader header{{'T', 'C', 'T', 'R'}, TRACE_VERSION, includeContent ? TRACE_FLAG_CONTENT : 0, 0,
+                                   std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()};
+            fwrite(&header, sizeof(header), 1, m_file);
+            m_includeContent = includeContent;
+            m_start = std::chrono::steady_clock::now();
+            m_numDropped = 0;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                m_running = true;
+
+            }
+
+            m_writerThread = boost::thread{boost::bind(&TraceCapture::runWriter, this)};
+            m_active.store(true, std::memory_order_release);
+            return true;
+
+        }
+
+        // Stop() writes every record still buffered and closes the trace file.
+        void stop()
+        {
+
+            m_active.store(false, std::memory_order_release);
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+                m_running = false;
+
+            }
+
+            m_wakeup.notify_all();
+
+            if(m_writerThread.joinable()) { m_writerThread.join(); }
+
+            if(m_file != nullptr)
+            {
+
+                fclose(m_file);
+                m_file = nullptr;
+
+            }
+        }
+
+        // IsActive() returns true while a capture is in progress.
+        inline bool isActive() const noexcept
+        {
+
+            return m_active.load(std::memory_order_acquire);
+
+        }
+
+        // GetNumDropped() returns the number of records of the current or last capture dropped because the disk fell behind.
+        inline uint64_t getNumDropped() const noexcept
+        {
+
+            return m_numDropped.load(std::memory_order_relaxed);
+
+        }
+
+        // Record(connectionId, tag, payload, payloadSize) appends a record for a frame received on connectionId.
+        void record(uint32_t connectionId, char tag, const char* payload, uint32_t payloadSize)
+        {
+
+            if(!isActive()) { return; }
+
+            const uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+            TraceRecordHeader header{timestamp, connectionId, payloadSize, tag};
+            bool full;
+
+            {
+
+                boost::lock_guard<boost::mutex> lock{m_mutex};
+
+                if(!m_running) { return; }
+
+                if(m_buffer.size() >= MAX_BUFFERED)
+                {
+
+                    m_numDropped++;
+                    return;
+
+                }
+
+                const char* headerBytes = reinterpret_cast<const char*>(&header);
+                m_buffer.insert(m_buffer.end(), headerBytes, headerBytes + sizeof(header));
+
+                if(m_includeContent)
+                {
+
+                    m_buffer.insert(m_buffer.end(), payload, payload + payloadSize);
+
+                }
+
+                full = m_buffer.size() >= FLUSH_THRESHOLD;
+
+            }
+
+            if(full) { m_wakeup.notify_one(); }
+
+        }
+};
+
+// TraceReader loads a trace file written by TraceCapture.
+class TraceReader
+{
+
+    public:
+
+        TraceReader() = delete;
+
+        // Load(path, header, records) reads the trace file at path into header and records. It returns false if the
+        // file could not be opened or is not a trace file.
+        static bool load(const string& path, TraceFileHeader& header, std::vector<TraceRecord>& records)
+        {
+
+            FILE* file = fopen(path.c_str(), "rb");
+
+            if(file == nullptr) { return false; }
+
+            if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "TCTR", 4) != 0 || header.version != TRACE_VERSION)
+            {
+
+                fclose(file);
+                return false;
+
+            }
+
+            TraceRecord record;
+
+            while(fread(&record.header, sizeof(record.header), 1, file) == 1)
+            {
+
+                record.payload.clear();
+
+                if(header.flags & TRACE_FLAG_CONTENT)
+                {
+
+                    record.payload.resize(record.header.payloadSize);
+
+                    if(record.header.payloadSize > 0 && fread(&record.payload[0], 1, record.header.payloadSize, file) != record.header.payloadSize) { break; }
+
+                }
+
+                records.push_back(record);
+
+            }
+
+            fclose(file);
+            return true;
+
+        }
+};
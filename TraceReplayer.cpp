@@ -0,0 +1,413 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+// USER DEFINED IMPORTS
+#include "PacketTagTypes.cpp"
+#include "TraceCapture.cpp"
+
+using namespace boost::asio;
+using ip::tcp;
+using std::string;
+using std::cout;
+using std::endl;
+
+// TraceReplayer re-drives a trace captured by a Server against a live server. Every connection in the trace gets its own
+// TCP connection, and all of them are multiplexed onto a single io_service. Each replayed message carries the time it was
+// sent, so whichever replayed connection receives it can measure its delivery latency.
+class TraceReplayer
+{
+
+    private:
+
+        typedef std::chrono::steady_clock clock;
+
+        inline static const size_t DISPATCH_BATCH = 256; // At max speed, hand control back to the io_service after this many frames.
+        inline static const long DRAIN_IDLE_MS = 2000; // After the last frame, stop once nothing has been written or delivered for this long.
+
+        // ReplayConnection is the state of one replayed connection.
+        struct ReplayConnection
+        {
+
+            string nickname; // The nickname this connection registered with.
+            tcp::socket socket; // The connection to the server.
+            bool connected; // True once the connection has been established.
+            bool writing; // True while an async_write is in flight.
+            bool closing; // True once the trace has disconnected this connection; it closes after its outbox drains.
+            std::deque<string> outbox; // Frames waiting to be written.
+            string writeBuf; // The coalesced frames of the in-flight async_write.
+            string pending; // Received bytes that do not yet form a complete frame.
+            char readBuf[16384]; // The receive buffer.
+
+            ReplayConnection(io_service& ios, const string& nickname_) : nickname{nickname_}, socket{ios}, connected{false}, writing{false}, closing{false} {}
+
+        };
+
+        typedef boost::shared_ptr<ReplayConnection> ConnectionPtr;
+
+        io_service m_ioService; // Every replayed connection is multiplexed on this io_service.
+        tcp::endpoint m_endpoint; // The server to replay against.
+        double m_speed; // The replay speed multiplier. 0 replays as fast as possible.
+        std::vector<TraceRecord> m_records; // The records of the trace.
+        bool m_hasContent; // True if the trace carries payloads.
+        size_t m_nextRecord; // The index of the next record to replay.
+        boost::unordered_map<uint32_t, ConnectionPtr> m_connections; // Live replayed connections, keyed by traced connection id.
+        boost::unordered_map<string, uint32_t> m_tracedNicknames; // Traced nickname -> traced connection id (content traces only).
+        uint m_connectCount; // The number of connections opened so far; keeps reconnecting nicknames unique.
+        steady_timer m_timer; // Paces the replay and the final drain.
+        clock::time_point m_start; // When the replay started.
+        clock::time_point m_lastActivity; // When the most recent frame was written or message delivered.
+        uint64_t m_framesSent; // The number of frames written.
+        uint64_t m_bytesSent; // The number of bytes written.
+        std::vector<int64_t> m_latencies; // The delivery latency of every message received, in nanoseconds.
+
+        // ElapsedNs() returns the number of nanoseconds since the replay started.
+        int64_t elapsedNs() const
+        {
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start).count();
+
+        }
+
+        // GetConnection(id) returns the replayed connection for the traced connection id, opening it if needed.
+        ConnectionPtr getConnection(uint32_t id)
+        {
+
+            auto itr = m_connections.find(id);
+
+            if(itr != m_connections.end()) { return itr->second; }
+
+            ConnectionPtr conn{new ReplayConnection{m_ioService, "replay" + std::to_string(id) + "_" + std::to_string(m_connectCount++)}};
+            m_connections.emplace(id, conn);
+            conn->socket.async_connect(m_endpoint, boost::bind(&TraceReplayer::handleConnect, this, conn, boost::asio::placeholders::error));
+            send(conn, PacketTagTypes::PKT_NICKNAME + conn->nickname + ";");
+            return conn;
+
+        }
+
+        // MakePayload(size, prefix) returns a payload that carries the current send time, padded to size bytes.
+        string makePayload(size_t size, const string& prefix)
+        {
+
+            string payload = prefix + "~T" + std::to_string(elapsedNs()) + "~";
+
+            if(payload.size() < size)
+            {
+
+                payload.append(size - payload.size(), 'x');
+
+            }
+
+            return payload;
+
+        }
+
+        // Dispatch(record) replays a single record.
+        void dispatch(const TraceRecord& record)
+        {
+
+            const uint32_t id = record.header.connectionId;
+
+            if(record.header.tag == TRACE_EVENT_DISCONNECT)
+            {
+
+                auto itr = m_connections.find(id);
+
+                if(itr != m_connections.end())
+                {
+
+                    itr->second->closing = true;
+                    closeIfDrained(itr->second);
+                    m_connections.erase(itr);
+
+                }
+
+                return;
+
+            }
+
+            if(record.header.tag == PacketTagTypes::PKT_NICKNAME[1])
+            {
+
+                if(m_hasContent) { m_tracedNicknames[record.payload] = id; }
+
+                getConnection(id);
+
+            }
+            else if(record.header.tag == PacketTagTypes::PKT_MESSAGE[1])
+            {
+
+                ConnectionPtr conn = getConnection(id);
+                send(conn, PacketTagTypes::PKT_MESSAGE + makePayload(record.header.payloadSize, "[" + conn->nickname + "]: ") + ";");
+
+            }
+            else if(record.header.tag == PacketTagTypes::PKT_PM[1])
+            {
+
+                ConnectionPtr conn = getConnection(id);
+                string target;
+
+                // Resolve the traced recipient to its replayed connection when possible; otherwise pick any other live connection.
+                if(m_hasContent)
+                {
+
+                    auto itr = m_tracedNicknames.find(record.payload.substr(0, record.payload.find(' ')));
+
+                    if(itr != m_tracedNicknames.end() && m_connections.count(itr->second) > 0) { target = m_connections[itr->second]->nickname; }
+
+                }
+
+                for(auto itr = m_connections.begin(); target.empty() && itr != m_connections.end(); itr++)
+                {
+
+                    if(itr->first != id) { target = itr->second->nickname; }
+
+                }
+
+                if(target.empty()) { return; }
+
+                send(conn, PacketTagTypes::PKT_PM + target + " " + makePayload(record.header.payloadSize, "") + ";");
+
+            }
+        }
+
+        // ScheduleNext() replays every record that is due, then waits for the next one.
+        void scheduleNext()
+        {
+
+            size_t dispatched = 0;
+
+            while(m_nextRecord < m_records.size())
+            {
+
+                const TraceRecord& record = m_records[m_nextRecord];
+
+                if(m_speed > 0)
+                {
+
+                    const int64_t due = static_cast<int64_t>(record.header.timestamp / m_speed);
+
+                    if(due > elapsedNs())
+                    {
+
+                        m_timer.expires_after(std::chrono::nanoseconds(due - elapsedNs()));
+                        m_timer.async_wait(boost::bind(&TraceReplayer::scheduleNext, this));
+                        return;
+
+                    }
+                }
+                else if(dispatched == DISPATCH_BATCH)
+                {
+
+                    m_ioService.post(boost::bind(&TraceReplayer::scheduleNext, this));
+                    return;
+
+                }
+
+                dispatch(record);
+                dispatched++;
+                m_nextRecord++;
+
+            }
+
+            m_lastActivity = clock::now();
+            waitForDrain();
+
+        }
+
+        // WaitForDrain() stops the replay once nothing has been written or delivered for DRAIN_IDLE_MS.
+        void waitForDrain()
+        {
+
+            if(clock::now() - m_lastActivity > std::chrono::milliseconds(DRAIN_IDLE_MS))
+            {
+
+                for(auto& p : m_connections)
+                {
+
+                    boost::system::error_code ignored;
+                    p.second->socket.close(ignored);
+
+                }
+
+                m_ioService.stop();
+                return;
+
+            }
+
+            m_timer.expires_after(std::chrono::milliseconds(100));
+            m_timer.async_wait(boost::bind(&TraceReplayer::waitForDrain, this));
+
+        }
+
+        // Send(conn, frame) queues frame for conn, and starts writing if nothing is in flight.
+        void send(const ConnectionPtr& conn, const string& frame)
+        {
+
+            conn->outbox.push_back(frame);
+            startWrite(conn);
+
+        }
+
+        // CloseIfDrained(conn) closes conn if the trace disconnected it and every frame queued for it has been written.
+        void closeIfDrained(const ConnectionPtr& conn)
+        {
+
+            if(!conn->closing || conn->writing || !conn->outbox.empty()) { return; }
+
+            boost::system::error_code ignored;
+            conn->socket.close(ignored);
+
+        }
+
+        // StartWrite(conn) coalesces every queued frame of conn into a single async_write.
+        void startWrite(const ConnectionPtr& conn)
+        {
+
+            if(!conn->connected || conn->writing || conn->outbox.empty())
+            {
+
+                closeIfDrained(conn);
+                return;
+
+            }
+
+            conn->writeBuf.clear();
+
+            while(!conn->outbox.empty())
+            {
+
+                conn->writeBuf += conn->outbox.front();
+                conn->outbox.pop_front();
+                m_framesSent++;
+
+            }
+
+            conn->writing = true;
+            boost::asio::async_write(conn->socket, boost::asio::buffer(conn->writeBuf), boost::bind(&TraceReplayer::handleWrite, this, conn, boost::asio::placeholders::error));
+
+        }
+
+        // HandleConnect(conn, error) starts reading from and writing to conn once it is connected.
+        void handleConnect(ConnectionPtr conn, const boost::system::error_code& error)
+        {
+
+            if(error) { return; }
+
+            conn->connected = true;
+            startRead(conn);
+            startWrite(conn);
+
+        }
+
+        // HandleWrite(conn, error) continues with the next batch of frames queued for conn.
+        void handleWrite(ConnectionPtr conn, const boost::system::error_code& error)
+        {
+
+            conn->writing = false;
+
+            if(error) { return; }
+
+            m_bytesSent += conn->writeBuf.size();
+            m_lastActivity = clock::now();
+            startWrite(conn);
+
+        }
+
+        // StartRead(conn) reads the next chunk of frames relayed to conn.
+        void startRead(const ConnectionPtr& conn)
+        {
+
+            conn->socket.async_read_some(boost::asio::buffer(conn->readBuf), boost::bind(&TraceReplayer::handleRead, this, conn, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+
+        }
+
+        // HandleRead(conn, error, numBytes) measures the delivery latency of every complete frame received on conn.
+        void handleRead(ConnectionPtr conn, const boost::system::error_code& error, size_t numBytes)
+        {
+
+            if(error) { return; }
+
+            conn->pending.append(conn->readBuf, numBytes);
+            size_t frameStart = 0;
+
+            for(size_t terminatorIndex; (terminatorIndex = conn->pending.find(';', frameStart)) != string::npos; frameStart = terminatorIndex + 1)
+            {
+
+                const size_t markerIndex = conn->pending.find("~T", frameStart);
+
+                if(markerIndex < terminatorIndex)
+                {
+
+                    const int64_t sentAt = strtoll(conn->pending.c_str() + markerIndex + 2, nullptr, 10);
+                    m_latencies.push_back(elapsedNs() - sentAt);
+                    m_lastActivity = clock::now();
+
+                }
+            }
+
+            conn->pending.erase(0, frameStart);
+            startRead(conn);
+
+        }
+
+        // Percentile(sorted, p) returns the p-th percentile of sorted, in milliseconds.
+        static double percentile(const std::vector<int64_t>& sorted, double p)
+        {
+
+            if(sorted.empty()) { return 0; }
+
+            return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()))] / 1e6;
+
+        }
+
+    public:
+
+        // Suppress copy semantics.
+        TraceReplayer(const TraceReplayer& rhs) = delete;
+        TraceReplayer& operator=(const TraceReplayer& rhs) = delete;
+
+        // Three-parameter constructor that targets the server at host and port. A speed of 2 replays twice as fast as
+        // the trace was captured; a speed of 0 replays as fast as possible.
+        TraceReplayer(const string& host, const uint& port, double speed) : m_endpoint{boost::asio::ip::address::from_string(host), static_cast<unsigned short>(port)}, m_speed{speed}, m_hasContent{false}, m_nextRecord{0}, m_connectCount{0}, m_timer{m_ioService}, m_framesSent{0}, m_bytesSent{0} {}
+
+        // Load(path) loads the trace file at path. It returns false if the file is not a trace file.
+        bool load(const string& path)
+        {
+
+            TraceFileHeader header;
+
+            if(!TraceReader::load(path, header, m_records)) { return false; }
+
+            m_hasContent = (header.flags & TRACE_FLAG_CONTENT) != 0;
+            return true;
+
+        }
+
+        // Run() replays the whole trace, waits for the last deliveries and prints a report to the standard output stream.
+        void run()
+        {
+
+            m_start = clock::now();
+            m_ioService.post(boost::bind(&TraceReplayer::scheduleNext, this));
+            m_ioService.run();
+
+            const double seconds = std::chrono::duration<double>(m_lastActivity - m_start).count();
+            std::sort(m_latencies.begin(), m_latencies.end());
+
+            cout << "Replayed " << m_framesSent << " frames (" << m_bytesSent << " bytes) over " << m_connectCount << " connections in " << seconds << " s" << endl;
+            cout << "Throughput: " << (seconds > 0 ? m_framesSent / seconds : 0) << " frames/s sent, " << (seconds > 0 ? m_latencies.size() / seconds : 0) << " messages/s delivered" << endl;
+            cout << "Delivery latency (ms) over " << m_latencies.size() << " deliveries: p50 " << percentile(m_latencies, 50) << ", p90 " << percentile(m_latencies, 90)
+                 << ", p99 " << percentile(m_latencies, 99) << ", p99.9 " << percentile(m_latencies, 99.9) << ", max " << percentile(m_latencies, 100) << endl;
+
+        }
+};